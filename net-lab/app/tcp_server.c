@@ -10,11 +10,15 @@ void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_i
         putchar('\n');
     fflush(stdout);
 
+    tcp_set_nodelay(tcp_conn, 1);                            // 交互式回显，不等待凑满报文段
     tcp_send(tcp_conn, data, len, 60000, src_ip, src_port);  // 发送tcp包
 }
 #endif
 
 int main(int argc, char const *argv[]) {
+    int ret = net_config_parse_args(argc, argv);  // 读取配置文件与命令行参数
+    if (ret != 0)
+        return ret < 0 ? -1 : 0;
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
         return -1;
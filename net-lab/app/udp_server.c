@@ -10,9 +10,22 @@ void udp_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port)
     putchar('\n');
     udp_send(data, len, 60000, src_ip, src_port);  // 发送udp包
 }
+
+#ifdef IPV6
+void udp6_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    printf("recv udp6 packet from [%s]:%u len=%zu\n", ip6tos(src_ip), src_port, len);
+    for (int i = 0; i < len; i++)
+        putchar(data[i]);
+    putchar('\n');
+    udp6_send(data, len, 60000, src_ip, src_port);  // 从ipv6端口应答
+}
+#endif
 #endif
 
 int main(int argc, char const *argv[]) {
+    int ret = net_config_parse_args(argc, argv);  // 读取配置文件与命令行参数
+    if (ret != 0)
+        return ret < 0 ? -1 : 0;
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
         return -1;
@@ -20,6 +33,9 @@ int main(int argc, char const *argv[]) {
 
 #ifdef UDP
     udp_open(60000, udp_handler);  // 注册端口的udp监听回调
+#ifdef IPV6
+    udp6_open(60000, udp6_handler);
+#endif
 #endif
 
     while (1) {
@@ -5,6 +5,7 @@
 #define HTTP_MAX_PATH_LENGTH 1024
 #define HTTP_MAX_RESPONSE_LENGTH 1024
 #define HTTP_LISTEN_PORT 80
+#define HTTP_MAX_TRANSFER_NUM 16  // 最多同时进行中的响应个数
 
 /**
  * @brief 根据文件路径返回对应的 MIME 类型
@@ -27,8 +28,102 @@ static inline const char *http_get_mime_type(const char *file_path) {
     return "application/octet-stream";  // 默认类型
 }
 
+typedef struct http_transfer {  // 一个连接上尚未全部排队的响应
+    FILE *file;                            // 响应体尚未读完的文件，为 NULL 时只剩 buf 中的数据
+    uint8_t peer_closed;                   // 对端已关闭（CLOSE_WAIT），响应发完后关闭本端
+    size_t len;                            // buf 中的数据长度
+    size_t off;                            // buf 中已排队的数据长度
+    char buf[HTTP_MAX_RESPONSE_LENGTH];    // 响应头或最近读出的文件内容块
+} http_transfer_t;
+
+static map_t http_transfers;  // 连接句柄 -> 尚未全部排队的响应
+
+/**
+ * @brief 响应已全部排队或连接已不可用：关闭文件，注销回调，对端已关闭时关闭本端
+ *
+ * @param tcp_conn  指向当前 TCP 连接的指针
+ * @param transfer  当前连接的响应
+ * @param dst_ip    目标 IP 地址
+ * @param dst_port  目标端口
+ */
+static void http_transfer_done(tcp_conn_t *tcp_conn, http_transfer_t *transfer, uint8_t *dst_ip, uint16_t dst_port) {
+    tcp_handle_t handle = tcp_conn_handle(tcp_conn);
+    uint8_t peer_closed = transfer->peer_closed;
+    if (transfer->file)
+        fclose(transfer->file);
+    map_delete(&http_transfers, &handle);
+    tcp_set_writable(tcp_conn, NULL);
+    tcp_set_close_handler(tcp_conn, NULL);
+    if (peer_closed)
+        tcp_conn_close(tcp_conn, HTTP_LISTEN_PORT, dst_ip, dst_port);
+}
+
+/**
+ * @brief 继续排队连接上的响应，发送队列已满时停在当前位置，等发送队列腾出空间后再继续
+ *
+ * @param tcp_conn  指向当前 TCP 连接的指针
+ * @param dst_ip    目标 IP 地址
+ * @param dst_port  目标端口
+ */
+static void http_transfer_resume(tcp_conn_t *tcp_conn, uint8_t *dst_ip, uint16_t dst_port) {
+    tcp_handle_t handle = tcp_conn_handle(tcp_conn);
+    http_transfer_t *transfer = map_get(&http_transfers, &handle);
+    if (!transfer)
+        return;
+
+    while (1) {
+        if (transfer->off == transfer->len) {
+            // 当前块已全部排队，读取下一块文件内容
+            transfer->len = transfer->file ? fread(transfer->buf, 1, sizeof(transfer->buf), transfer->file) : 0;
+            transfer->off = 0;
+            if (transfer->len == 0)
+                break;
+        }
+        int queued = tcp_send(tcp_conn, (uint8_t *)transfer->buf + transfer->off, transfer->len - transfer->off, HTTP_LISTEN_PORT, dst_ip, dst_port);
+        // 连接已不能发送数据，放弃其余的响应
+        if (queued < 0) {
+            http_transfer_done(tcp_conn, transfer, dst_ip, dst_port);
+            return;
+        }
+        transfer->off += queued;
+        // 发送队列已满，等对端确认后由可写回调继续
+        if (transfer->off < transfer->len)
+            return;
+    }
+
+    tcp_flush(tcp_conn, HTTP_LISTEN_PORT, dst_ip, dst_port);
+    http_transfer_done(tcp_conn, transfer, dst_ip, dst_port);
+}
+
+/**
+ * @brief 发送队列腾出空间，继续排队连接上的响应
+ */
+static void http_writable_handler(tcp_conn_t *tcp_conn, size_t len, uint8_t *dst_ip, uint16_t dst_port) {
+    http_transfer_resume(tcp_conn, dst_ip, dst_port);
+}
+
+/**
+ * @brief 连接关闭：对端只关闭了发送方向时继续发完响应再关闭本端，连接被复位或超时则放弃响应
+ */
+static void http_close_handler(tcp_conn_t *tcp_conn, uint8_t *src_ip, uint16_t src_port, int status) {
+    tcp_handle_t handle = tcp_conn_handle(tcp_conn);
+    http_transfer_t *transfer = map_get(&http_transfers, &handle);
+    if (!transfer) {
+        if (status == 0)
+            tcp_conn_close(tcp_conn, HTTP_LISTEN_PORT, src_ip, src_port);
+        return;
+    }
+    if (status == 0) {
+        transfer->peer_closed = 1;
+        return;
+    }
+    transfer->peer_closed = 0;
+    http_transfer_done(tcp_conn, transfer, src_ip, src_port);
+}
+
 /**
  * @brief 响应函数
+ * 响应头与响应体经由连接的 http_transfer_t 排队，发送队列放不下的部分在对端确认后继续发送，不会截断响应体
  *
  * @param tcp_conn  指向当前 TCP 连接的指针
  * @param url_path  资源文件路径
@@ -37,7 +132,12 @@ static inline const char *http_get_mime_type(const char *file_path) {
  * @param dst_port  目标端口
  */
 void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *dst_ip, uint16_t dst_port) {
-    FILE *file;
+    tcp_handle_t handle = tcp_conn_handle(tcp_conn);
+    // 上一个响应尚未发完，不处理流水线上的下一个请求
+    if (map_get(&http_transfers, &handle))
+        return;
+
+    http_transfer_t transfer = {0};
     char file_path[HTTP_MAX_PATH_LENGTH];
     memcpy(file_path, HTTP_RESOURCE_DIR, sizeof(HTTP_RESOURCE_DIR));
 
@@ -48,78 +148,51 @@ void http_respond(tcp_conn_t *tcp_conn, char *url_path, uint16_t port, uint8_t *
         strcat(file_path, url_path);  // 否则，文件路径为 "${HTTP_RESOURCE_DIR}${url_path}"
     }
     // 打开文件
-    file = fopen(file_path, "rb");
-
-    char resp_buffer[HTTP_MAX_RESPONSE_LENGTH] = {0};
+    transfer.file = fopen(file_path, "rb");
 
+    char *resp_buffer = transfer.buf;
     // 文件不存在时发送 404 响应
-    if (! file) {
+    if (! transfer.file) {
         // HTTP 404 响应请求体
         char *not_found_body = "<HTML><TITLE>Not Found</TITLE>\r\n"
                                "The resource specified\r\n"
                                "is unavailable or nonexistent.\r\n"
                                "</BODY></HTML>\r\n";
-        /* Step1 ：发送 HTTP 404 请求头 */
-        // 发送 HTTP 状态行
-        sprintf(resp_buffer, "HTTP/1.1 404 Not Found\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-        // 发送 HTTP 连接信息
-        sprintf(resp_buffer, "Connection: Keep-Alive\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-        // 发送 HTTP 内容类型
-        sprintf(resp_buffer, "Content-Type: text/html; charset=utf-8\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-        // 发送 HTTP 内容长度
-        sprintf(resp_buffer, "Content-Length: %zu\r\n", strlen(not_found_body));
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-        // 发送 HTTP 响应头与响应体的分隔符
-        sprintf(resp_buffer, "\r\n");
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-        // 发送 HTTP 响应体
-        tcp_send(tcp_conn, (uint8_t *)not_found_body, strlen( not_found_body ), port, dst_ip, dst_port);
-
-        return;
+        /* Step1 ：写出 HTTP 404 响应头与响应体 */
+        transfer.len = sprintf(resp_buffer, "HTTP/1.1 404 Not Found\r\n"             // HTTP 状态行
+                                            "Connection: Keep-Alive\r\n"             // HTTP 连接信息
+                                            "Content-Type: text/html; charset=utf-8\r\n"  // HTTP 内容类型
+                                            "Content-Length: %zu\r\n"                // HTTP 内容长度
+                                            "\r\n"                                    // 响应头与响应体的分隔符
+                                            "%s",                                     // HTTP 响应体
+                               strlen(not_found_body), not_found_body);
+    } else {
+        /* Step2 ：写出 HTTP 响应头，响应体由 http_transfer_resume() 逐块读出 */
+        fseek(transfer.file, 0, SEEK_END);
+        size_t content_length = ftell(transfer.file);
+        fseek(transfer.file, 0, SEEK_SET);
+        transfer.len = sprintf(resp_buffer, "HTTP/1.1 200 OK\r\n"      // HTTP 状态行
+                                            "Connection: Keep-Alive\r\n"  // HTTP 连接信息
+                                            "Content-Type: %s\r\n"      // HTTP 内容类型，根据文件类型设置 MIME 类型
+                                            "Content-Length: %zu\r\n"   // HTTP 内容长度
+                                            "\r\n",                     // 响应头与响应体的分隔符
+                               http_get_mime_type(file_path), content_length);
     }
 
-    /* Step2 ：发送 HTTP 请求头 */
-    // 发送 HTTP 状态行
-    sprintf(resp_buffer, "HTTP/1.1 200 OK\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-    // 发送 HTTP 连接信息
-    sprintf(resp_buffer, "Connection: Keep-Alive\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-    const char *content_type = http_get_mime_type( file_path );
-    // 发送 HTTP 内容类型，根据文件类型设置 MIME 类型
-    sprintf(resp_buffer, "Content-Type: %s\r\n", content_type);
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-    fseek(file, 0, SEEK_END);
-    size_t content_length = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    // 发送 HTTP 内容长度
-    sprintf(resp_buffer, "Content-Length: %zu\r\n", content_length);
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-    // 发送 HTTP 响应头与响应体的分隔符
-    sprintf(resp_buffer, "\r\n");
-    tcp_send(tcp_conn, (uint8_t *)resp_buffer, strlen( resp_buffer ), port, dst_ip, dst_port);
-
-    /* Step3 ：发送 HTTP 响应体 */
-    size_t bytes_read;
-    while ((bytes_read = fread(resp_buffer, 1, sizeof( resp_buffer ), file)) > 0) {
-        // 每次发送读取的文件内容块
-        tcp_send(tcp_conn, (uint8_t *)resp_buffer, bytes_read, port, dst_ip, dst_port);
+    // 同时进行中的响应过多，无法记录发送进度，关闭连接而不是发出不完整的响应
+    if (map_set(&http_transfers, &handle, &transfer) != 0) {
+        if (transfer.file)
+            fclose(transfer.file);
+        tcp_conn_close(tcp_conn, port, dst_ip, dst_port);
+        return;
     }
 
-    // 后处理: 关闭文件
-    fclose( file );
+    /* Step3 ：排队响应，直到全部排队或发送队列已满 */
+    // 响应由多次 tcp_send() 写出，先塞住连接，结束时一并刷出，合并为满 MSS 的报文段
+    tcp_cork(tcp_conn);
+    tcp_set_writable(tcp_conn, http_writable_handler);
+    tcp_set_close_handler(tcp_conn, http_close_handler);
+    http_transfer_resume(tcp_conn, dst_ip, dst_port);
 }
 
 void http_request_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
@@ -146,11 +219,15 @@ void http_request_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8
 }
 
 int main(int argc, char const *argv[]) {
+    int ret = net_config_parse_args(argc, argv);  // 读取配置文件与命令行参数
+    if (ret != 0)
+        return ret < 0 ? -1 : 0;
     if (net_init() == -1) {  // 初始化协议栈
         printf("net init failed.");
         return -1;
     }
 
+    map_init(&http_transfers, sizeof(tcp_handle_t), sizeof(http_transfer_t), HTTP_MAX_TRANSFER_NUM, 0, NULL, NULL);
     tcp_open(HTTP_LISTEN_PORT, http_request_handler);  // 注册端口的tcp监听回调
 
     while (1) {
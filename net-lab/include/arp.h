@@ -22,10 +22,13 @@ typedef struct arp_pkt {
 
 #pragma pack()
 
+extern uint32_t arp_gen;
+
 void arp_init();
 void arp_print();
 void arp_in(buf_t *buf, uint8_t *src_mac);
 void arp_out(buf_t *buf, uint8_t *ip);
+uint8_t *arp_lookup(uint8_t *ip);
 void arp_req(uint8_t *target_ip);
-void arp_resp(uint8_t *target_ip, uint8_t *target_mac);
+void arp_resp(uint8_t *target_ip, uint8_t *target_mac, uint8_t *sender_ip);
 #endif
\ No newline at end of file
@@ -6,6 +6,14 @@
     {                      \
         192, 168, 163, 103 \
     }  // 测试用网卡ip地址
+#define NET_IF_MASK        \
+    {                      \
+        255, 255, 255, 0   \
+    }  // 测试用网卡子网掩码
+#define NET_IF_GATEWAY     \
+    {                      \
+        192, 168, 163, 1   \
+    }  // 测试用默认网关
 #define NET_IF_MAC                         \
     {                                      \
         0x11, 0x22, 0x33, 0x44, 0x55, 0x66 \
@@ -15,6 +23,14 @@
     {                    \
         10, 251, 136, 101      \
     }  // 自定义网卡ip地址
+#define NET_IF_MASK      \
+    {                    \
+        255, 255, 255, 0 \
+    }  // 自定义网卡子网掩码
+#define NET_IF_GATEWAY   \
+    {                    \
+        10, 251, 136, 1  \
+    }  // 自定义默认网关
 #define NET_IF_MAC                         \
     {                                      \
         0x00, 0x11, 0x22, 0x33, 0x44, 0x55 \
@@ -26,9 +42,12 @@
 #define ARP_TIMEOUT_SEC (60 * 5)  // arp表过期时间
 #define ARP_MIN_INTERVAL 1        // 向相同地址发送arp请求的最小间隔
 
-#define IP_DEFALUT_TTL 64  // IP默认TTL
-
 #define BUF_MAX_LEN (2 * UINT16_MAX + UINT8_MAX)  // buf最大长度
 
 #define MAP_MAX_LEN (16 * BUF_MAX_LEN)  // map最大长度
+
+#define NET_CONFIG_LINE_LEN 256  // 配置文件一行的最大长度
+
+int net_config_load(const char *path);
+int net_config_parse_args(int argc, char const *argv[]);
 #endif
\ No newline at end of file
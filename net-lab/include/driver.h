@@ -8,6 +8,9 @@
 #endif
 int driver_open();
 int driver_recv(buf_t *buf);
+int driver_recv_if(int ifindex, buf_t *buf);
 int driver_send(buf_t *buf);
+int driver_send_if(int ifindex, buf_t *buf);
+int driver_update_filter(int ifindex);
 void driver_close();
 #endif
\ No newline at end of file
@@ -16,6 +16,8 @@ typedef struct ether_hdr {
 void ethernet_init();
 void ethernet_in(buf_t *buf);
 void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol);
+void ethernet_out_if(int ifindex, buf_t *buf, const uint8_t *mac, net_protocol_t protocol);
+void ethernet_out_prebuilt(int ifindex, buf_t *buf, const ether_hdr_t *hdr);
 void ethernet_poll();
 static const uint8_t ether_broadcast_mac[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};  // 以太网广播mac地址
 #endif
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef ICMP6_H
+#define ICMP6_H
+
+#include "ip6.h"
+#include "net.h"
+
+#pragma pack(1)
+typedef struct icmp6_hdr {
+    uint8_t type;         // 类型
+    uint8_t code;         // 代码
+    uint16_t checksum16;  // ICMPv6报文的校验和，含ipv6伪首部
+    uint32_t data32;      // 回显报文为标识符与序号，差错报文为参数
+} icmp6_hdr_t;
+#pragma pack()
+
+typedef enum icmp6_type {
+    ICMP6_TYPE_UNREACH = 1,             // 目的不可达
+    ICMP6_TYPE_PARAM_PROBLEM = 4,       // 参数问题，data32 为出错字段在原数据报中的偏移
+    ICMP6_TYPE_ECHO_REQUEST = 128,      // 回显请求
+    ICMP6_TYPE_ECHO_REPLY = 129,        // 回显响应
+    ICMP6_TYPE_NEIGHBOR_SOLICIT = 135,  // 邻居请求
+    ICMP6_TYPE_NEIGHBOR_ADVERT = 136,   // 邻居通告
+} icmp6_type_t;
+
+typedef enum icmp6_code {
+    ICMP6_CODE_UNKNOWN_NEXT_HEADER = 1,  // 参数问题：无法识别的下一个首部
+    ICMP6_CODE_PORT_UNREACH = 4,         // 端口不可达
+} icmp6_code_t;
+
+#define ICMP6_ERROR_MAX_LEN (IP6_MIN_MTU - IP6_HDR_LEN - sizeof(icmp6_hdr_t))  // 差错报文中引用的原数据报的最大长度
+
+void icmp6_in(buf_t *buf, uint8_t *src_ip);
+void icmp6_error(buf_t *recv_buf, uint8_t *src_ip, icmp6_type_t type, icmp6_code_t code, uint32_t param);
+void icmp6_init();
+#endif
@@ -0,0 +1,76 @@
+#ifndef IGMP_H
+#define IGMP_H
+
+#include "net.h"
+
+#pragma pack(1)
+typedef struct igmp_hdr {
+    uint8_t type;                // 类型
+    uint8_t max_resp;            // 最大响应时间（查询报文），单位0.1秒
+    uint16_t checksum16;         // IGMP报文的校验和
+    uint8_t group[NET_IP_LEN];   // 组播地址，通用查询为全0
+} igmp_hdr_t;
+
+typedef struct igmp_v3_report {  // IGMPv3 成员报告首部，其后为若干组记录
+    uint8_t type;             // 类型，固定为 IGMP_TYPE_V3_REPORT
+    uint8_t reserved;         // 保留
+    uint16_t checksum16;      // IGMP报文的校验和
+    uint16_t reserved16;      // 保留
+    uint16_t record_num16;    // 组记录个数
+} igmp_v3_report_t;
+
+typedef struct igmp_v3_record {  // IGMPv3 组记录，本协议栈只支持不带源地址列表的记录
+    uint8_t type;               // 记录类型
+    uint8_t aux_len;            // 辅助数据长度，固定为0
+    uint16_t src_num16;         // 源地址个数，固定为0
+    uint8_t group[NET_IP_LEN];  // 组播地址
+} igmp_v3_record_t;
+#pragma pack()
+
+typedef enum igmp_type {
+    IGMP_TYPE_QUERY = 0x11,      // 成员查询，按报文长度与最大响应时间区分v1/v2/v3
+    IGMP_TYPE_V1_REPORT = 0x12,  // v1 成员报告
+    IGMP_TYPE_V2_REPORT = 0x16,  // v2 成员报告
+    IGMP_TYPE_V2_LEAVE = 0x17,   // v2 离开组
+    IGMP_TYPE_V3_REPORT = 0x22,  // v3 成员报告
+} igmp_type_t;
+
+typedef enum igmp_record_type {
+    IGMP_MODE_IS_EXCLUDE = 2,       // 应答查询：接收该组的所有源
+    IGMP_CHANGE_TO_INCLUDE = 3,     // 状态变化：离开该组
+    IGMP_CHANGE_TO_EXCLUDE = 4,     // 状态变化：加入该组
+} igmp_record_type_t;
+
+#define IGMP_MIN_LEN 8                          // v1/v2 报文长度，也是最短的IGMP报文
+#define IGMP_V3_QUERY_MIN_LEN 12                // v3 查询报文的最短长度
+#define IGMP_ROBUSTNESS 2                       // 健壮性变量：主动报告的发送次数
+#define IGMP_UNSOLICITED_INTERVAL_MS 1000       // 主动报告重传的最大间隔
+#define IGMP_DEFAULT_MAX_RESP 100               // v1 查询未给出最大响应时间时的取值，单位0.1秒
+#define IGMP_OLDER_QUERIER_TIMEOUT_MS (IGMP_ROBUSTNESS * 125 * 1000 + 10 * 1000)  // 收到旧版本查询后退回旧版本的时长
+#define IGMP_POLL_INTERVAL_MS 100               // 检查待发报告的间隔
+
+#pragma pack(1)
+typedef struct igmp_key {  // 一个待发报告所属的网卡与组
+    uint8_t ifindex;              // 网卡编号
+    uint8_t group[NET_IP_LEN];    // 组播地址
+} igmp_key_t;
+#pragma pack()
+
+typedef struct igmp_timer {  // 一个组的待发报告
+    uint64_t due;          // 下次发送的时间（毫秒）
+    uint8_t count;         // 剩余发送次数
+    uint8_t record_type;   // 报告的记录类型，决定发送成员报告还是离开报文
+} igmp_timer_t;
+
+typedef struct igmp_if {  // 一块网卡上的IGMP状态
+    uint64_t v1_until;     // 在此之前网段上有v1查询者，以v1报告应答
+    uint64_t v2_until;     // 在此之前网段上有v2查询者，以v2报告应答
+    uint64_t general_due;  // v3 通用查询的合并应答时间，为0表示没有待发应答
+} igmp_if_t;
+
+void igmp_in(buf_t *buf, uint8_t *src_ip);
+int igmp_join(int ifindex, const uint8_t *group);
+int igmp_leave(int ifindex, const uint8_t *group);
+void igmp_init();
+void igmp_poll();
+#endif
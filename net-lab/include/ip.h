@@ -1,6 +1,7 @@
 #ifndef IP_H
 #define IP_H
 
+#include "ethernet.h"
 #include "net.h"
 
 #pragma pack(1)
@@ -23,6 +24,7 @@ typedef struct ip_hdr {
 #define IP_HDR_OFFSET_PER_BYTE 8    // ip分片偏移长度单位
 #define IP_VERSION_4 4              // ipv4
 #define IP_MORE_FRAGMENT (1 << 13)  // ip分片mf位
+#define IP_DONT_FRAGMENT (1 << 14)  // ip分片df位
 #define IP_DEFAULT_TOS    0         // 服务类型默认值
 #define IP_DEFAULT_TTL    64        // 默认生存时间
 #define IP_MTU            1500    // 以太网MTU（最大传输单元）
@@ -30,7 +32,112 @@ typedef struct ip_hdr {
 #define IP_HDR_BYTES      (IP_HDR_LEN * IP_HDR_LEN_PER_BYTE) // IP头部字节数（20）
 #define IP_MAX_PAYLOAD    (IP_MTU - IP_HDR_BYTES) // IP最大载荷（1480字节）
 #define IP_MIN_HDR_LEN    (IP_HDR_LEN * IP_HDR_LEN_PER_BYTE) // IP头部最小长度（20字节）
+#define IP_MAX_HDR_LEN    (15 * IP_HDR_LEN_PER_BYTE)         // IP头部最大长度（60字节）
+#define IP_OFFSET_MASK    0x1fff                             // ip分片偏移字段掩码（8字节为单位）
+#define IP_IS_MULTICAST(ip) (((ip)[0] & 0xf0) == 0xe0)       // 是否是组播地址（224.0.0.0/4）
+#define IP_MULTICAST_TTL  1                                  // 组播数据报的默认生存时间，只在本网段内传播
+#define IP_ROUTER_ALERT_LEN 4                                // 路由器告警选项长度（RFC 2113）
+
+#define IP_REASM_MAX_LEN (UINT16_MAX - IP_MIN_HDR_LEN)  // 单个重组数据报的最大载荷长度
+#define IP_REASM_MAX_HOLES 16                           // 单个重组数据报最多记录的空洞数
+#define IP_REASM_MEM_LIMIT (256 * 1024)                 // 所有重组数据报占用的缓存块总字节数上限
+#define IP_REASM_CHUNK_LEN 1024                         // 重组缓存块长度，数据报只为收到过载荷的块分配缓存
+#define IP_REASM_CHUNK_NUM ((IP_REASM_MAX_LEN + IP_REASM_CHUNK_LEN - 1) / IP_REASM_CHUNK_LEN)  // 单个数据报最多占用的块数
+#define IP_REASM_POOL_NUM 4096                          // 重组缓存池的块数，全局上限不超过其总字节数
+#define IP_REASM_TIMEOUT_MS (30 * 1000)                 // 自收到第一个分片起的重组超时时间
+#define IP_REASM_SWEEP_MS 1000                          // 检查重组超时的间隔
+
+#define IP_PMTU_MIN 576                 // 路径MTU下限，低于此值的通告被钳位，并改为允许分片
+#define IP_PMTU_TIMEOUT_SEC (10 * 60)  // 路径MTU缓存的有效期，过期后恢复为 IP_MTU 重新探测
+#define IP_PMTU_MAX_NUM 64             // 路径MTU缓存的最大条目数
+
+#pragma pack(1)
+typedef struct ip_reasm_key {  // 标识一个被分片的数据报
+    uint8_t src_ip[NET_IP_LEN];  // 源IP
+    uint8_t dst_ip[NET_IP_LEN];  // 目标IP
+    uint16_t id;                 // 标识符
+    uint8_t protocol;            // 上层协议
+} ip_reasm_key_t;
+#pragma pack()
+
+typedef struct ip_hole {  // 重组数据报中尚未收到的载荷区间 [first, end)
+    uint16_t first;
+    uint16_t end;
+} ip_hole_t;
+
+typedef struct ip_reasm {  // 一个正在重组的数据报（RFC 815 空洞描述符算法）
+    uint64_t deadline;                     // 重组超时的时间（毫秒）
+    uint32_t mem;                          // 已分配的缓存块字节数，计入全局上限
+    uint16_t total_len;                    // 载荷总长度，收到最后一个分片前为0
+    uint8_t hdr_len;                       // 首个分片的首部长度，0表示尚未收到首个分片
+    uint8_t hole_num;                      // 空洞个数，为0时重组完成
+    ip_hole_t holes[IP_REASM_MAX_HOLES];   // 空洞描述符
+    uint8_t hdr[IP_MAX_HDR_LEN];           // 首个分片的首部，用作重组后数据报的首部
+    uint16_t chunks[IP_REASM_CHUNK_NUM];   // 各段载荷所在的缓存块编号加一，0表示尚未分配
+} ip_reasm_t;
+
+#define IP_ROUTE_MAX_NUM 64                            // 路由表最大条目数
+#define IP_ROUTE_STRIDE 8                              // 路由 trie 每层消耗的地址位数
+#define IP_ROUTE_FANOUT (1 << IP_ROUTE_STRIDE)         // 路由 trie 每个节点的分支数
+#define IP_ROUTE_NODE_MAX_NUM (IP_ROUTE_MAX_NUM * 3 + 1)  // 每条路由最多新建3个非根节点
+
+typedef struct ip_route {  // 一条路由
+    uint8_t dst[NET_IP_LEN];      // 目的网络
+    uint8_t netmask[NET_IP_LEN];  // 子网掩码
+    uint8_t gateway[NET_IP_LEN];  // 网关，全0表示目的网络直连，下一跳即目的地址
+    uint8_t prefix_len;           // 子网掩码的前缀长度
+    uint32_t metric;              // 度量，前缀相同时取较小者
+} ip_route_t;
+
+typedef struct ip_route_node {  // 路由 trie 的一个节点，按地址的一个字节分支
+    uint16_t child[IP_ROUTE_FANOUT];  // 子节点编号，0表示无（根节点不会成为子节点）
+    uint16_t route[IP_ROUTE_FANOUT];  // 前缀展开到本层的最长匹配路由编号加1，0表示无
+} ip_route_node_t;
+
+#define IP_DST_CACHE_SIZE 256        // 目的地址缓存的槽数，必须是2的幂
+#define IP_DST_CACHE_TIMEOUT_SEC 10  // 目的地址缓存项的有效期，过期后重新查找路由与arp表
+
+typedef struct ip_dst {  // 一个目的地址的发送缓存：下一跳已解析，以太网包头已填好
+    uint8_t ip[NET_IP_LEN];  // 目的地址
+    uint32_t route_gen;      // 填写时的路由表版本号
+    uint32_t arp_gen;        // 填写时的arp表版本号
+    time_t expire;           // 失效时间，为0表示空槽
+    uint8_t ifindex;         // 出口网卡编号
+    ether_hdr_t eth_hdr;     // 以太网包头模板
+} ip_dst_t;
+
+typedef struct ip_tmpl {  // 一条连接的以太网与IP首部模板，发送时整体拷贝后只填写长度、标识符与校验和
+    ether_hdr_t eth_hdr;  // 以太网包头
+    uint8_t ifindex;      // 出口网卡编号
+    ip_hdr_t ip_hdr;      // IP首部，总长度、标识符与校验和为0
+    uint32_t ip_sum;      // IP首部固定字段的部分校验和
+    uint16_t mtu;         // 路径MTU
+    uint32_t route_gen;   // 生成时的路由表版本号
+    uint32_t arp_gen;     // 生成时的arp表版本号
+    uint32_t pmtu_gen;    // 生成时的路径MTU缓存版本号
+    time_t expire;        // 失效时间，为0表示尚未生成
+} ip_tmpl_t;
+
+typedef struct ip_pmtu {  // 一个目的地址的路径MTU
+    uint16_t mtu;    // 路径MTU
+    uint8_t locked;  // 对端通告的MTU低于 IP_PMTU_MIN，不再设置DF位
+} ip_pmtu_t;
+
+extern uint32_t ip_pmtu_gen;
+extern uint8_t ip_in_dst[NET_IP_LEN];
+
 void ip_in(buf_t *buf, uint8_t *src_mac);
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol);
+void ip_out_src(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol);
+void ip_out_pmtu(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol);
+void ip_out_router_alert(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol);
+void ip_out_tmpl(ip_tmpl_t *tmpl, buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol);
+void ip_src_select(uint8_t *ip, uint8_t *src);
+int ip_route_add(uint8_t *dst, uint8_t *netmask, uint8_t *gateway, uint32_t metric);
+int ip_route_delete(uint8_t *dst, uint8_t *netmask);
+const ip_route_t *ip_route_lookup(uint8_t *ip);
+uint16_t ip_pmtu(uint8_t *ip);
+void ip_pmtu_update(uint8_t *ip, uint16_t mtu);
 void ip_init();
+void ip_poll();
 #endif
\ No newline at end of file
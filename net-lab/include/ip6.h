@@ -0,0 +1,45 @@
+#ifndef IP6_H
+#define IP6_H
+
+#include "net.h"
+
+#pragma pack(1)
+typedef struct ip6_hdr {
+    uint32_t ver_tc_flow32;        // 版本号4位、流量类别8位与流标签20位
+    uint16_t payload_len16;        // 载荷长度，含扩展首部
+    uint8_t next_header;           // 下一个首部
+    uint8_t hop_limit;             // 跳数限制
+    uint8_t src_ip[NET_IP6_LEN];   // 源IP
+    uint8_t dst_ip[NET_IP6_LEN];   // 目标IP
+} ip6_hdr_t;
+
+typedef struct ip6_ext_hdr {  // 逐跳选项、路由与目的选项扩展首部的公共部分
+    uint8_t next_header;  // 下一个首部
+    uint8_t hdr_len;      // 首部长度，8字节为单位，不含前8字节
+} ip6_ext_hdr_t;
+#pragma pack()
+
+#define IP6_VERSION 6                  // ipv6
+#define IP6_HDR_LEN 40                 // 固定首部长度
+#define IP6_MIN_MTU 1280               // ipv6链路MTU下限
+#define IP6_EXT_UNIT 8                 // 扩展首部长度单位
+#define IP6_ND_HOP_LIMIT 255           // 邻居发现报文的跳数限制，接收时据此确认报文来自本链路
+#define IP6_MULTICAST_HOP_LIMIT 1      // 组播数据报的默认跳数限制，只在本链路内传播
+#define IP6_EXT_HOP_BY_HOP 0           // 逐跳选项首部
+#define IP6_EXT_ROUTING 43             // 路由首部
+#define IP6_EXT_FRAGMENT 44            // 分片首部
+#define IP6_EXT_DEST_OPTS 60           // 目的选项首部
+#define IP6_IS_MULTICAST(ip) ((ip)[0] == 0xff)                                  // 是否是组播地址（ff00::/8）
+#define IP6_IS_LINK_LOCAL(ip) ((ip)[0] == 0xfe && ((ip)[1] & 0xc0) == 0x80)    // 是否是链路本地地址（fe80::/10）
+
+extern uint8_t ip6_in_dst[NET_IP6_LEN];
+extern uint8_t ip6_in_hop_limit;
+extern uint16_t ip6_in_hdr_len;
+
+void ip6_in(buf_t *buf, uint8_t *src_mac);
+void ip6_out(buf_t *buf, const uint8_t *src, const uint8_t *dst, uint8_t next_header);
+void ip6_out_hop_limit(buf_t *buf, const uint8_t *src, const uint8_t *dst, uint8_t next_header, uint8_t hop_limit);
+void ip6_src_select(const uint8_t *dst, uint8_t *src);
+void ip6_add_protocol(uint8_t next_header, net_handler_t handler);
+void ip6_init();
+#endif
@@ -0,0 +1,35 @@
+#ifndef ND_H
+#define ND_H
+
+#include "net.h"
+
+#pragma pack(1)
+typedef struct nd_msg {  // 邻居请求与邻居通告报文，其后为选项
+    uint8_t type;                    // 类型
+    uint8_t code;                    // 代码，固定为0
+    uint16_t checksum16;             // ICMPv6报文的校验和
+    uint32_t flags32;                // 邻居通告的标志位，邻居请求中保留为0
+    uint8_t target[NET_IP6_LEN];     // 目标地址
+} nd_msg_t;
+
+typedef struct nd_opt_lla {  // 源/目标链路层地址选项
+    uint8_t type;              // 选项类型
+    uint8_t len;               // 选项长度，8字节为单位
+    uint8_t mac[NET_MAC_LEN];  // mac地址
+} nd_opt_lla_t;
+#pragma pack()
+
+#define ND_OPT_SRC_LLA 1               // 源链路层地址选项
+#define ND_OPT_TARGET_LLA 2            // 目标链路层地址选项
+#define ND_NA_FLAG_ROUTER (1u << 31)   // 通告者是路由器
+#define ND_NA_FLAG_SOLICITED (1 << 30) // 应答邻居请求
+#define ND_NA_FLAG_OVERRIDE (1 << 29)  // 覆盖已有的邻居缓存
+
+void nd_in(buf_t *buf, uint8_t *src_ip);
+void nd_out(int ifindex, buf_t *buf, const uint8_t *next_hop);
+uint8_t *nd_lookup(const uint8_t *ip);
+void nd_solicit(int ifindex, const uint8_t *target);
+void nd_advert(int ifindex, const uint8_t *dst, const uint8_t *target, uint32_t flags);
+void nd_print();
+void nd_init();
+#endif
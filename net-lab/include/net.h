@@ -10,6 +10,7 @@
 typedef enum net_protocol {
     NET_PROTOCOL_ARP = 0x0806,
     NET_PROTOCOL_IP = 0x0800,
+    NET_PROTOCOL_IPV6 = 0x86dd,
 #ifdef ICMP
     NET_PROTOCOL_ICMP = 1,
 #else
@@ -25,17 +26,110 @@ typedef enum net_protocol {
 #else
     NET_PROTOCOL_TCP = 0xff,
 #endif
+#ifdef IGMP
+    NET_PROTOCOL_IGMP = 2,
+#else
+    NET_PROTOCOL_IGMP = 0xff,
+#endif
+#ifdef IPV6
+    NET_PROTOCOL_ICMPV6 = 58,
+#else
+    NET_PROTOCOL_ICMPV6 = 0xff,
+#endif
 } net_protocol_t;
 
 typedef void (*net_handler_t)(buf_t *buf, uint8_t *src);
 
 #define NET_MAC_LEN 6  // mac地址长度
 #define NET_IP_LEN 4   // ip地址长度
+#define NET_IP6_LEN 16 // ipv6地址长度
+
+#define NET_IF_MAX_NUM 4        // 网卡表最大条目数
+#define NET_IF_ADDR_MAX_NUM 8   // 每块网卡最多配置的ip地址数
+#define NET_IF_NAME_LEN 64      // 网卡名最大长度
+#define NET_IF_GROUP_MAX_NUM 16 // 每块网卡最多加入的组播组数
+#define NET_IF_ADDR6_MAX_NUM 4  // 每块网卡最多配置的ipv6地址数，含链路本地地址
+
+typedef struct net_if_addr {  // 网卡上配置的一个ip地址
+    uint8_t ip[NET_IP_LEN];       // ip地址
+    uint8_t netmask[NET_IP_LEN];  // 子网掩码
+} net_if_addr_t;
+
+typedef struct net_if_addr6 {  // 网卡上配置的一个ipv6地址
+    uint8_t ip[NET_IP6_LEN];  // ipv6地址
+    uint8_t prefix_len;       // 前缀长度，前缀内的地址视为直连
+} net_if_addr6_t;
+
+typedef struct net_if {  // 一块网卡，对应一个驱动实例
+    char name[NET_IF_NAME_LEN];                 // 驱动打开的网卡名，为空时按首个地址选择
+    uint8_t mac[NET_MAC_LEN];                   // mac地址
+    net_if_addr_t addrs[NET_IF_ADDR_MAX_NUM];   // ip地址，第一个为主地址，其余为从地址
+    uint8_t addr_num;                           // ip地址个数
+    uint8_t allmulti;                           // 是否接收所有组播数据报
+    uint8_t groups[NET_IF_GROUP_MAX_NUM][NET_IP_LEN];  // 加入的组播组，据此过滤组播mac地址与目的地址
+    uint8_t group_num;                          // 加入的组播组个数
+    net_if_addr6_t addrs6[NET_IF_ADDR6_MAX_NUM];  // ipv6地址，第一个为由mac地址生成的链路本地地址
+    uint8_t addr6_num;                          // ipv6地址个数
+} net_if_t;
+
+#define NET_CONFIG_ADDR_MAX_NUM (NET_IF_ADDR_MAX_NUM - 1)     // 配置中主网卡从地址的最大个数
+#define NET_CONFIG_ADDR6_MAX_NUM (NET_IF_ADDR6_MAX_NUM - 1)   // 配置中主网卡ipv6地址的最大个数
+
+typedef struct net_config {  // 运行时配置，默认值取自编译期的宏，可由配置文件与命令行参数覆盖
+    char if_name[NET_IF_NAME_LEN];                  // 主网卡名，为空时按主地址选择
+    uint8_t netmask[NET_IP_LEN];                    // 主地址的子网掩码
+    uint8_t gateway[NET_IP_LEN];                    // 默认网关
+    net_if_addr_t addrs[NET_CONFIG_ADDR_MAX_NUM];   // 主网卡上的从地址
+    uint8_t addr_num;                               // 从地址个数
+    uint8_t groups[NET_IF_GROUP_MAX_NUM][NET_IP_LEN];  // 启动时主网卡加入的组播组
+    uint8_t group_num;                              // 启动时加入的组播组个数
+    net_if_addr6_t addrs6[NET_CONFIG_ADDR6_MAX_NUM];  // 主网卡上链路本地地址之外的ipv6地址
+    uint8_t addr6_num;                              // ipv6地址个数
+    uint8_t gateway6[NET_IP6_LEN];                  // ipv6默认网关，全0表示只能访问直连的地址
+    uint32_t mtu;                                   // 链路MTU，也是路径MTU的初始值
+    uint32_t ttl;                                   // 发出数据报的TTL
+    uint32_t arp_timeout_sec;                       // arp表项的有效期
+    uint32_t arp_min_interval_sec;                  // 向相同地址发送arp请求的最小间隔
+    uint32_t arp_max_num;                           // arp表最大条目数，0为按map容量
+    uint32_t ip_reasm_timeout_ms;                   // 分片重组超时时间
+    uint32_t ip_reasm_mem_limit;                    // 所有重组数据报占用的缓存块总字节数上限，不超过重组缓存池容量
+    uint32_t ip_pmtu_timeout_sec;                   // 路径MTU缓存的有效期
+    uint32_t ip_pmtu_max_num;                       // 路径MTU缓存的最大条目数
+    uint32_t ip_dst_cache_timeout_sec;              // 目的地址缓存项的有效期
+    uint32_t tcp_max_conn_num;                      // 连接数上限，不超过连接池容量
+    uint32_t tcp_max_buf_num;                       // 收发缓冲区数上限，不超过收发缓冲区池容量
+    uint32_t tcp_syn_cookie_threshold;              // 全局半连接数达到该值后改用 SYN cookie 应答
+    uint32_t tcp_syn_backlog;                       // 监听者默认的半连接队列长度
+    uint32_t tcp_accept_backlog;                    // 监听者默认的已建立连接数上限
+    uint32_t tcp_time_wait_ms;                      // TIME_WAIT 状态的持续时间
+    uint32_t tcp_data_retries;                      // 数据的最大连续超时重传次数
+} net_config_t;
 
 extern uint8_t net_if_mac[NET_MAC_LEN];
 extern uint8_t net_if_ip[NET_IP_LEN];
+extern net_config_t net_config;
+extern net_if_t net_ifs[NET_IF_MAX_NUM];
+extern int net_if_num;
+extern int net_if_rx;
 extern buf_t rxbuf, txbuf;  // 一个buf足够单线程使用
 
+void net_if_init();
+int net_if_add(const char *name, const uint8_t *mac);
+int net_if_addr_add(int ifindex, const uint8_t *ip, const uint8_t *netmask);
+int net_if_lookup(const uint8_t *ip);
+int net_if_select(const uint8_t *ip, const uint8_t **src);
+int net_if_is_broadcast(const uint8_t *ip);
+int net_if_group_add(int ifindex, const uint8_t *group);
+int net_if_group_delete(int ifindex, const uint8_t *group);
+int net_if_group_member(int ifindex, const uint8_t *ip);
+void net_if_group_mac(const uint8_t *group, uint8_t *mac);
+int net_if_mac_accept(int ifindex, const uint8_t *mac);
+int net_if_addr6_add(int ifindex, const uint8_t *ip, uint8_t prefix_len);
+int net_if_lookup6(const uint8_t *ip);
+int net_if_select6(const uint8_t *ip, const uint8_t **src);
+void net_if_solicited_node(const uint8_t *ip, uint8_t *group);
+int net_if_group_member6(int ifindex, const uint8_t *ip);
+void net_if_group_mac6(const uint8_t *group, uint8_t *mac);
 int net_init();
 void net_poll();
 int net_in(buf_t *buf, uint16_t protocol, uint8_t *src);
@@ -1,6 +1,7 @@
 #ifndef TCP_H
 #define TCP_H
 
+#include "ip.h"
 #include "net.h"
 
 #pragma pack(1)
@@ -18,9 +19,11 @@ typedef struct tcp_hdr {
 #pragma pack()
 
 typedef struct tcp_key {
-    uint8_t remote_ip[NET_IP_LEN];
+    uint8_t remote_ip[NET_IP6_LEN];  // ipv4 地址只占前4字节，其余为0
+    uint8_t local_ip[NET_IP6_LEN];   // 本端地址，同上；被动打开时为 SYN 的目的地址，主动打开时按路由选择
     uint16_t remote_port;
     uint16_t host_port;
+    uint8_t v6;                      // 是否为 ipv6 连接
 } tcp_key_t;
 
 typedef enum tcp_state {
@@ -40,12 +43,84 @@ typedef enum tcp_state {
 typedef struct tcp_connection {
     /* TCP connection states */
     tcp_state_t state;
-    uint8_t not_send_empty_ack;
+    uint8_t sack_permitted;  // 双方是否协商启用 SACK
+    uint8_t wscale_ok;       // 双方是否协商启用窗口扩大选项
+    uint8_t ts_ok;           // 双方是否协商启用时间戳选项
+    uint8_t nodelay;         // 是否禁用 Nagle 算法
+    uint8_t corked;          // 是否暂缓发送不足 MSS 的数据，直到 tcp_flush()
+    uint8_t half_open;       // 是否为被动打开、尚未完成握手的半连接
+    uint8_t passive;         // 是否由监听者被动打开
+    uint8_t accepted;        // 是否计入监听者的已建立连接数
 
     /* TCP communication states */
     int port;
-    uint32_t seq;  // 要发送的序列号
-    uint32_t ack;  // 要发送的 ACK
+    uint32_t seq;      // 要发送的序列号
+    uint32_t ack;      // 要发送的 ACK
+    uint32_t una;         // 最早的未被确认的序列号
+    uint32_t snd_wnd;     // 对端通告的窗口大小（已按窗口扩大因子换算）
+    uint16_t mss;         // 对端声明的最大报文段长度
+    uint16_t path_mss;    // 按路径MTU计算的最大报文段长度
+    uint32_t pmtu_gen;    // 计算 path_mss 时路径MTU缓存的版本号，与 ip_pmtu_gen 不同时重新计算
+    uint8_t snd_wscale;   // 对端的窗口扩大因子
+    uint8_t rcv_wscale;   // 本端的窗口扩大因子
+    uint32_t ts_recent;   // 最近一次收到的对端时间戳，作为 TSecr 回显
+    uint32_t rcv_adv;     // 最近一次通告的接收窗口右边界（序列号）
+    void (*readable_handler)(struct tcp_connection *tcp_conn, size_t len, uint8_t *src_ip, uint16_t src_port);  // 非空时接收的数据先进入接收缓冲区
+    void (*writable_handler)(struct tcp_connection *tcp_conn, size_t len, uint8_t *dst_ip, uint16_t dst_port);   // 对端确认数据、发送队列腾出空间时调用
+
+    /* TCP delayed ACK states */
+    uint32_t ack_sent;    // 最近一次发出的确认号
+    uint8_t ack_pending;  // 自上次确认以来收到的、尚未确认的报文段个数
+    uint64_t ack_due;     // 延迟确认计时器的到期时间（毫秒）
+
+    uint64_t time_wait_due;  // TIME_WAIT 状态的到期时间（毫秒）
+
+    /* TCP handshake states */
+    uint8_t syn_retries;  // SYN 或 SYN-ACK 已重传的次数
+    uint64_t syn_due;     // SYN 或 SYN-ACK 重传计时器的到期时间（毫秒）
+    void (*connect_handler)(struct tcp_connection *tcp_conn, uint8_t *dst_ip, uint16_t dst_port, int status);  // 主动打开完成回调
+    void (*handler)(struct tcp_connection *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port);  // 主动打开时指定的数据处理程序，为空时交付给端口的监听者
+    void (*close_handler)(struct tcp_connection *tcp_conn, uint8_t *src_ip, uint16_t src_port, int status);  // 关闭回调，为空时收到 FIN 后随即关闭本端
+
+    /* TCP keepalive and idle states (ms) */
+    uint64_t last_recv;           // 最近一次收到报文段的时间
+    uint64_t last_active;         // 最近一次收发数据的时间
+    uint32_t idle_timeout;        // 空闲超时时间，0 表示不限
+    uint32_t keepalive_idle;      // 多久未收到报文段后开始保活探测，0 表示不探测
+    uint32_t keepalive_interval;  // 保活探测的间隔
+    uint8_t keepalive_probes;     // 最多发送的保活探测次数
+    uint8_t probes_sent;          // 已发送、尚未得到回应的保活探测次数
+
+    /* TCP RTT estimation states (ms) */
+    uint32_t srtt;    // 平滑往返时间，0 表示尚无样本
+    uint32_t rttvar;  // 往返时间偏差
+    uint32_t rto;     // 重传超时时间
+
+    /* TCP loss recovery states */
+    uint8_t dup_acks;     // 连续收到的重复 ACK 个数
+    uint8_t in_recovery;  // 是否处于快速恢复阶段
+    uint32_t recover;     // 进入快速恢复时的 seq，累计确认越过它后退出恢复
+    uint64_t persist_due; // 坚持计时器的到期时间（毫秒），对端窗口关闭且没有在途数据时启动，0 表示未启动
+
+    /* TCP header templates */
+    tcp_hdr_t hdr_tmpl;   // 端口已填好的 TCP 首部模板
+    uint32_t pseudo_sum;  // 伪首部中 IP 地址与协议的部分校验和，0 表示模板尚未生成
+    ip_tmpl_t ip_tmpl;    // 以太网与 IP 首部模板
+
+    /* TCP connection table links, maintained by the table and kept by tcp_rst() */
+    tcp_key_t key;                         // 连接的键
+    uint8_t in_use;                        // 连接池中的该位置是否已分配
+    uint32_t gen;                          // 该位置的代数，每次释放后加一，使旧的句柄失效
+    struct tcp_connection *hash_next;      // 同一哈希桶中的下一个连接，空闲时为空闲链表中的下一个位置
+    struct tcp_connection *port_prev;      // 同一本地端口上的前一个连接
+    struct tcp_connection *port_next;      // 同一本地端口上的后一个连接
+    struct tcp_connection *timer_prev;     // 计时轮同一槽中的前一个连接
+    struct tcp_connection *timer_next;     // 计时轮同一槽中的后一个连接
+    uint64_t timer_due;                    // 挂入计时轮时最早的到期时间（毫秒），0 表示未挂入
+    uint16_t timer_slot;                   // 所在的计时轮槽
+    struct tcp_txq *txq;                   // 发送与重传队列，从收发缓冲区池按需分配，没有时为空
+    struct tcp_ooo *ooo;                   // 乱序队列，同上
+    struct tcp_rxq *rxq;                   // 接收缓冲区，同上
 } tcp_conn_t;
 
 #define TCP_FLG_URG (1 << 5)
@@ -57,18 +132,163 @@ typedef struct tcp_connection {
 
 #define TCP_FLG_ISSET(x, y) (((x & 0x3f) & (y)) ? 1 : 0)
 
+#define TCP_SEQ_LT(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)   // 考虑回绕的序列号比较 a < b
+#define TCP_SEQ_LEQ(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) <= 0)  // a <= b
+#define TCP_SEQ_GT(a, b) TCP_SEQ_LT(b, a)                                   // a > b
+#define TCP_SEQ_GEQ(a, b) TCP_SEQ_LEQ(b, a)                                 // a >= b
+
 #define TCP_HEADER_LEN 20
-#define TCP_RETRANSMISSON_TIMEOUT 3
+#define TCP_RETRANSMISSON_TIMEOUT 3   // 初始重传超时时间（秒），尚无 RTT 样本时使用
+#define TCP_MIN_RTO_MS 200            // 重传超时时间下限
+#define TCP_MAX_RTO_MS (60 * 1000)    // 重传超时时间上限
+#define TCP_TIMER_INTERVAL_MS 10      // 连接计时器的检查间隔
+#define TCP_TIMER_WHEEL_SIZE 4096     // 计时轮的槽数，每槽一个检查间隔，必须为2的幂
+#define TCP_DELAYED_ACK_MS 200        // 延迟确认的最长等待时间
+#define TCP_DELAYED_ACK_SEGS 2        // 每收到多少个报文段立即确认一次
+#define TCP_TIME_WAIT_MS (60 * 1000)  // TIME_WAIT 状态的持续时间（2MSL）
+#define TCP_SYN_RETRIES 5             // SYN 与 SYN-ACK 的最大重传次数
+#define TCP_DATA_RETRIES 15           // 数据的最大连续超时重传次数，用尽后复位连接
+#define TCP_SYN_COOKIE_THRESHOLD 128  // 全局半连接数达到该值后改用无状态的 SYN cookie 应答
+#define TCP_SYN_BACKLOG 128           // 监听者默认的半连接队列长度
+#define TCP_ACCEPT_BACKLOG 256        // 监听者默认的已建立连接数上限
+#define TCP_SYN_COOKIE_PERIOD 64      // SYN cookie 计数器的周期（秒），cookie 在两个周期内有效
+#define TCP_EPHEMERAL_PORT_MIN 49152  // 主动打开时自动分配的本地端口下限
+#define TCP_KEEPALIVE_IDLE_MS (2 * 60 * 60 * 1000)  // 监听者默认的保活探测开始时间
+#define TCP_KEEPALIVE_INTERVAL_MS (75 * 1000)       // 监听者默认的保活探测间隔
+#define TCP_KEEPALIVE_PROBES 9                      // 监听者默认的保活探测次数
+#define TCP_RST_RATE 100                            // 每秒最多回复的 RST 个数（针对关闭的端口与无效报文段）
+#define TCP_RST_BURST 100                           // RST 令牌桶的容量
+#define TCP_SWEEP_BATCH 256                         // 每次轮询检查保活与空闲超时的连接个数
 #define TCP_MAX_WINDOW_SIZE UINT16_MAX
-#define TCP_MAX_CONN_NUM (MAP_MAX_LEN / (sizeof(tcp_key_t) + sizeof(tcp_conn_t) + sizeof(time_t)))
+#define TCP_WINDOW_SCALE 2                                              // 本端的窗口扩大因子
+#define TCP_RCV_WINDOW ((uint32_t)TCP_MAX_WINDOW_SIZE << TCP_WINDOW_SCALE)  // 启用窗口扩大后通告的接收窗口
+#define TCP_MAX_CONN_NUM 256      // 连接池容量，连接池与缓冲区池均为静态数组，按实验规模取值
+#define TCP_CONN_HASH_SIZE 64     // 连接表哈希桶个数，必须为2的幂
+#define TCP_BUF_POOL_NUM 64       // 收发缓冲区池容量（每个约 64KB），同时存在未确认、乱序或未读取数据的连接共用
+#define TCP_DEFAULT_MSS 1460      // 默认最大报文段长度（以太网 MTU - IP 首部 - TCP 首部）
+#define TCP_PEER_DEFAULT_MSS 536  // 对端未声明 MSS 时使用的默认值
+#define TCP_DUP_ACK_THRESHOLD 3   // 触发快速重传的重复 ACK 个数
+
+#define TCP_OPT_EOL 0             // 选项列表结束
+#define TCP_OPT_NOP 1             // 无操作，用于对齐
+#define TCP_OPT_MSS 2             // 最大报文段长度，仅出现在 SYN 报文中
+#define TCP_OPT_WSCALE 3          // 窗口扩大因子，仅出现在 SYN 报文中
+#define TCP_OPT_SACK_PERMITTED 4  // 允许 SACK，仅出现在 SYN 报文中
+#define TCP_OPT_SACK 5            // SACK 区间
+#define TCP_OPT_TIMESTAMP 8       // 时间戳
+#define TCP_OPT_TIMESTAMP_LEN 12  // 时间戳选项对齐后的长度
+#define TCP_OPT_MAX_LEN 40        // 选项最大长度
+#define TCP_MAX_WSCALE 14         // 窗口扩大因子上限
+#define TCP_SACK_MAX_BLOCKS 4     // 一个报文段最多携带的 SACK 区间数
+
+typedef struct tcp_block {
+    uint32_t left;   // 区间起始序列号
+    uint32_t right;  // 区间结束序列号（不含）
+} tcp_block_t;
+
+typedef struct tcp_opts {  // 从报文段中解析出的 TCP 选项
+    uint16_t mss;                           // 最大报文段长度，0 表示未携带
+    uint8_t wscale_ok;                      // 是否携带窗口扩大选项
+    uint8_t wscale;                         // 窗口扩大因子
+    uint8_t sack_permitted;                 // 是否携带 SACK-Permitted
+    uint8_t sack_num;                       // SACK 区间个数
+    tcp_block_t sack[TCP_SACK_MAX_BLOCKS];  // SACK 区间
+    uint8_t ts_ok;                          // 是否携带时间戳选项
+    uint32_t ts_val;                        // 对端时间戳
+    uint32_t ts_ecr;                        // 对端回显的本端时间戳
+} tcp_opts_t;
+
+#define TCP_OOO_MAX_BLOCKS TCP_SACK_MAX_BLOCKS  // 乱序队列最多维护的不连续区间数
+#define TCP_OOO_BUF_LEN TCP_MAX_WINDOW_SIZE     // 乱序队列缓存长度，不超过通告窗口
+
+typedef struct tcp_ooo {  // 一个连接的乱序接收队列，按序列号区间记录已缓存的数据
+    uint32_t base;                           // data[0] 对应的序列号，即当前连接的 ack
+    uint8_t block_num;                       // 有效区间个数
+    uint8_t fin;                             // 是否缓存了乱序到达的 FIN
+    uint32_t fin_seq;                        // 乱序 FIN 的序列号
+    uint32_t last_seq;                       // 最近一次缓存的报文段的序列号，用于排列 SACK 区间
+    tcp_block_t blocks[TCP_OOO_MAX_BLOCKS];  // 按序列号升序排列、互不相邻的区间
+    uint8_t data[TCP_OOO_BUF_LEN];           // 以 base 为起点的数据缓存
+} tcp_ooo_t;
+
+#define TCP_TXQ_BUF_LEN TCP_MAX_WINDOW_SIZE  // 重传队列缓存长度
+#define TCP_RXQ_BUF_LEN TCP_MAX_WINDOW_SIZE  // 接收缓冲区长度，即使用接收缓冲区的连接通告的最大窗口
+
+typedef struct tcp_txq {  // 一个连接的重传队列，缓存已发送但未被确认的数据
+    uint32_t base;                            // data[0] 对应的序列号，即连接的 una
+    uint32_t len;                             // 缓存的数据长度
+    uint64_t rto_time;                        // 重传计时器的起点（毫秒）
+    uint8_t backoff;                          // 指数退避的次数，重传超时时间达到上限后不再增加
+    uint8_t retries;                          // 连续超时重传的次数，超过上限后复位连接
+    uint8_t fin;                              // 数据之后是否排队了 FIN，FIN 占用序列号 base + len
+    uint32_t rexmit_next;                     // 恢复阶段下一个待检查的重传序列号
+    uint8_t sacked_num;                       // 记分板区间个数
+    tcp_block_t sacked[TCP_SACK_MAX_BLOCKS];  // 记分板：对端已 SACK 的区间，升序排列
+    uint8_t data[TCP_TXQ_BUF_LEN];            // 以 base 为起点的数据缓存
+} tcp_txq_t;
+
+typedef struct tcp_rxq {  // 一个连接的接收缓冲区，缓存已确认但应用程序尚未读取的数据
+    uint32_t len;                   // 缓存的数据长度
+    uint8_t data[TCP_RXQ_BUF_LEN];  // 按序到达的数据
+} tcp_rxq_t;
+
+typedef uint64_t tcp_handle_t;  // 连接句柄，高32位为代数，低32位为连接池中的位置，0为无效句柄
 
 typedef void (*tcp_handler_t)(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port);
+typedef void (*tcp_connect_handler_t)(tcp_conn_t *tcp_conn, uint8_t *dst_ip, uint16_t dst_port, int status);  // status 为0表示连接建立，-1表示被拒绝或超时
+typedef void (*tcp_readable_handler_t)(tcp_conn_t *tcp_conn, size_t len, uint8_t *src_ip, uint16_t src_port);  // 接收缓冲区有数据可读时调用，len 为可读的字节数
+typedef void (*tcp_writable_handler_t)(tcp_conn_t *tcp_conn, size_t len, uint8_t *dst_ip, uint16_t dst_port);  // 发送队列腾出空间时调用，len 为可写入的字节数
+typedef int (*tcp_accept_handler_t)(uint8_t *src_ip, uint16_t src_port, uint16_t dst_port);              // 收到 SYN 时调用，返回非0则以 RST 拒绝
+typedef void (*tcp_established_handler_t)(tcp_conn_t *tcp_conn, uint8_t *src_ip, uint16_t src_port);   // 被动打开的连接完成握手时调用
+typedef void (*tcp_close_handler_t)(tcp_conn_t *tcp_conn, uint8_t *src_ip, uint16_t src_port, int status);  // status 为0表示对端已关闭（CLOSE_WAIT），由应用程序调用 tcp_conn_close()；-1表示连接被复位或超时，回调返回后连接即被释放
+
+typedef struct tcp_listen_opts {  // 监听者的配置，由 tcp_listen() 使用
+    size_t syn_backlog;                             // 半连接队列长度，超出后改用 SYN cookie 应答
+    size_t accept_backlog;                          // 已建立连接数上限，超出后丢弃新的 SYN
+    tcp_accept_handler_t accept_handler;            // 可以为 NULL
+    tcp_established_handler_t established_handler;  // 可以为 NULL
+    tcp_readable_handler_t readable_handler;        // 非空时连接使用接收缓冲区，由应用程序调用 tcp_read() 读取
+    uint32_t idle_timeout;                          // 连接没有数据收发的最长时间（毫秒），超时后以 RST 释放，0 表示不限
+    uint32_t keepalive_idle;                        // 多久未收到报文段后开始保活探测（毫秒），0 表示不探测
+    uint32_t keepalive_interval;                    // 保活探测的间隔（毫秒）
+    uint8_t keepalive_probes;                       // 探测均无回应时以 RST 释放连接
+    tcp_close_handler_t close_handler;              // 非空时收到 FIN 后停留在 CLOSE_WAIT，由应用程序决定何时关闭
+} tcp_listen_opts_t;
+
+typedef struct tcp_listener {  // 一个本地端口上的监听者
+    tcp_handler_t handler;      // 数据处理程序
+    tcp_listen_opts_t opts;     // 配置
+    size_t half_open_num;       // 尚未完成握手的半连接个数
+    size_t established_num;     // 已建立、尚未进入 TIME_WAIT 或释放的连接个数
+} tcp_listener_t;
 
 void tcp_init();
+void tcp_poll();
+void tcp_isn_init();
+uint32_t tcp_generate_initial_seq(const tcp_key_t *key);
 int tcp_open(uint16_t port, tcp_handler_t handler);
+int tcp_listen(uint16_t port, tcp_handler_t handler, tcp_listen_opts_t *opts);
 void tcp_close(uint16_t port);
+int tcp_connect(uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, tcp_handler_t handler, tcp_connect_handler_t connect_handler);
 
 void tcp_in(buf_t *buf, uint8_t *src_ip);
+#ifdef IPV6
+void tcp6_in(buf_t *buf, uint8_t *src_ip);
+int tcp6_connect(uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, tcp_handler_t handler, tcp_connect_handler_t connect_handler);
+#endif
 void tcp_out(tcp_conn_t *tcp_conn, buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, uint8_t flags);
-void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+int tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+void tcp_set_nodelay(tcp_conn_t *tcp_conn, uint8_t nodelay);
+void tcp_cork(tcp_conn_t *tcp_conn);
+void tcp_flush(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+int tcp_conn_close(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+void tcp_set_close_handler(tcp_conn_t *tcp_conn, tcp_close_handler_t close_handler);
+void tcp_set_readable(tcp_conn_t *tcp_conn, tcp_readable_handler_t readable_handler);
+void tcp_set_writable(tcp_conn_t *tcp_conn, tcp_writable_handler_t writable_handler);
+size_t tcp_read(tcp_conn_t *tcp_conn, uint8_t *data, size_t len);
+
+tcp_handle_t tcp_conn_handle(tcp_conn_t *tcp_conn);
+tcp_conn_t *tcp_conn_get(tcp_handle_t handle);
+int tcp_handle_send(tcp_handle_t handle, uint8_t *data, uint16_t len);
+int tcp_handle_close(tcp_handle_t handle);
 #endif
\ No newline at end of file
@@ -20,4 +20,11 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
 void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
 int udp_open(uint16_t port, udp_handler_t handler);
 void udp_close(uint16_t port);
+#ifdef IPV6
+void udp6_in(buf_t *buf, uint8_t *src_ip);
+void udp6_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+void udp6_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port);
+int udp6_open(uint16_t port, udp_handler_t handler);
+void udp6_close(uint16_t port);
+#endif
 #endif
\ No newline at end of file
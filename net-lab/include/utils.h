@@ -6,14 +6,40 @@
 #include <stdint.h>
 #include <time.h>
 
+#pragma pack(1)
+typedef struct peso_hdr {
+    uint8_t src_ip[4];     // 源IP地址
+    uint8_t dst_ip[4];     // 目的IP地址
+    uint8_t placeholder;   // 必须置0,用于填充对齐
+    uint8_t protocol;      // 协议号
+    uint16_t total_len16;  // 整个数据包的长度
+} peso_hdr_t;
+
+typedef struct peso6_hdr {   // ipv6伪首部（RFC 8200）
+    uint8_t src_ip[16];      // 源IP地址
+    uint8_t dst_ip[16];      // 目的IP地址
+    uint32_t total_len32;    // 上层数据包的长度
+    uint8_t zero[3];         // 必须置0
+    uint8_t next_header;     // 上层协议号
+} peso6_hdr_t;
+#pragma pack()
+
 uint16_t checksum16(uint16_t *data, size_t len);
+uint32_t checksum_partial(uint32_t sum, const void *data, size_t len);
+uint16_t checksum_finish(uint32_t sum);
 uint16_t transport_checksum(uint8_t protocol, buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip);
+uint16_t transport_checksum6(uint8_t protocol, buf_t *buf, const uint8_t *src_ip, const uint8_t *dst_ip);
 
 #define swap16(x) ((((x)&0xFF) << 8) | (((x) >> 8) & 0xFF))                                                  // 为16位数据交换大小端
 #define swap32(x) ((((x)&0xFF) << 24) | (((x)&0xFF00) << 8) | (((x)&0xFF0000) >> 8) | (((x) >> 24) & 0xFF))  // 为32位数据交换大小端
 
 char *iptos(uint8_t *ip);
+char *ip6tos(const uint8_t *ip);
 char *mactos(uint8_t *mac);
 char *timetos(time_t timestamp);
+uint64_t clock_ms();
+uint64_t clock_us();
+void random_bytes(uint8_t *buf, size_t len);
+uint64_t siphash24(const uint8_t key[16], const void *data, size_t len);
 uint8_t ip_prefix_match(uint8_t *ipa, uint8_t *ipb);
 #endif
\ No newline at end of file
@@ -5,19 +5,6 @@
 
 #include <stdio.h>
 #include <string.h>
-/**
- * @brief 初始的arp包
- *
- */
-static const arp_pkt_t arp_init_pkt = {
-    .hw_type16 = swap16(ARP_HW_ETHER),
-    .pro_type16 = swap16(NET_PROTOCOL_IP),
-    .hw_len = NET_MAC_LEN,
-    .pro_len = NET_IP_LEN,
-    .sender_ip = NET_IF_IP,
-    .sender_mac = NET_IF_MAC,
-    .target_mac = {0}};
-
 /**
  * @brief arp地址转换表，<ip,mac>的容器
  *
@@ -30,6 +17,12 @@ map_t arp_table;
  */
 map_t arp_buf;
 
+/**
+ * @brief arp表的版本号，已有表项的mac地址变化时递增，上层据此判断缓存的mac地址是否失效
+ *
+ */
+uint32_t arp_gen = 1;
+
 /**
  * @brief 打印一条arp表项
  *
@@ -57,6 +50,9 @@ void arp_print() {
  * @param target_ip 想要知道的目标的ip地址
  */
 void arp_req(uint8_t *target_ip) {
+    //选择目标ip所在网段的网卡与地址
+    const uint8_t *sender_ip;
+    int ifindex = net_if_select(target_ip, &sender_ip);
     //初始化缓冲区,arp头部长度为28字节
     buf_init(&txbuf, sizeof(arp_pkt_t));
     //填写ARP报头
@@ -66,13 +62,13 @@ void arp_req(uint8_t *target_ip) {
     arp_pkt->hw_len = 6;
     arp_pkt->pro_len = 4;
     arp_pkt->opcode16 = swap16(ARP_REQUEST);//apr请求包
-    memcpy(arp_pkt->sender_mac, net_if_mac, NET_MAC_LEN);//本机mac地址
-    memcpy(arp_pkt->sender_ip, net_if_ip, NET_IP_LEN);//本机ip地址
+    memcpy(arp_pkt->sender_mac, net_ifs[ifindex].mac, NET_MAC_LEN);//本机mac地址
+    memcpy(arp_pkt->sender_ip, sender_ip, NET_IP_LEN);//本机ip地址
     memset(arp_pkt->target_mac, 0, NET_MAC_LEN);//请求报文mac填全0
     memcpy(arp_pkt->target_ip, target_ip, NET_IP_LEN);//填入目标IP
     //调用ethernet_out 发送报文
     uint8_t broadcast_mac[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
-    ethernet_out(&txbuf, broadcast_mac, NET_PROTOCOL_ARP); 
+    ethernet_out_if(ifindex, &txbuf, broadcast_mac, NET_PROTOCOL_ARP);
 
 }
 
@@ -81,8 +77,9 @@ void arp_req(uint8_t *target_ip) {
  *
  * @param target_ip 目标ip地址
  * @param target_mac 目标mac地址
+ * @param sender_ip 被请求的本机地址，从收到请求的网卡应答
  */
-void arp_resp(uint8_t *target_ip, uint8_t *target_mac) {
+void arp_resp(uint8_t *target_ip, uint8_t *target_mac, uint8_t *sender_ip) {
     //初始化txbuf，缓冲区大小为ARP报文头部长度（sizeof(arp_pkt_t)=28字节）
     buf_init(&txbuf, sizeof(arp_pkt_t));
     //填写ARP报头首部（严格遵循ARP协议规范）解析缓冲区为ARP报文结构
@@ -98,16 +95,16 @@ void arp_resp(uint8_t *target_ip, uint8_t *target_mac) {
     //操作类型：ARP响应（2），转换为网络字节序
     arp_pkt->opcode16 = swap16(ARP_REPLY);
 
-    //发送方MAC/IP：本机的MAC和IP（响应方是本机）
-    memcpy(arp_pkt->sender_mac, net_if_mac, NET_MAC_LEN);
-    memcpy(arp_pkt->sender_ip, net_if_ip, NET_IP_LEN);
+    //发送方MAC/IP：收到请求的网卡的MAC和被请求的IP（响应方是本机）
+    memcpy(arp_pkt->sender_mac, net_ifs[net_if_rx].mac, NET_MAC_LEN);
+    memcpy(arp_pkt->sender_ip, sender_ip, NET_IP_LEN);
 
     //目标方MAC/IP：传入的target_mac和target_ip（即ARP请求方的MAC/IP）
     memcpy(arp_pkt->target_mac, target_mac, NET_MAC_LEN);
     memcpy(arp_pkt->target_ip, target_ip, NET_IP_LEN);
 
     // Step3: 发送ARP报文 调用以太网层发送ARP响应（单播，目标MAC=请求方MAC，协议类型=ARP）
-    ethernet_out(&txbuf, target_mac, NET_PROTOCOL_ARP);
+    ethernet_out_if(net_if_rx, &txbuf, target_mac, NET_PROTOCOL_ARP);
 }
 
 /**
@@ -140,23 +137,27 @@ void arp_in(buf_t *buf, uint8_t *src_mac) {
     if (opcode != ARP_REQUEST && opcode != ARP_REPLY) {
         return;
     }
-    //更新ARP表项
+    //更新ARP表项，mac地址变化时使上层缓存的mac地址失效
+    uint8_t *old_mac = map_get(&arp_table, arp_pkt->sender_ip);
+    if (old_mac != NULL && memcmp(old_mac, arp_pkt->sender_mac, NET_MAC_LEN)) {
+        arp_gen++;
+    }
     map_set(&arp_table, arp_pkt->sender_ip, arp_pkt->sender_mac);
     //检查arp_buf缓存情况
     buf_t *cached_buf = map_get(&arp_buf, arp_pkt->sender_ip);
     // 情况1：有缓存 → 发送缓存的IP数据包，并删除缓存
     if (cached_buf != NULL) {
         // 调用以太网层发送缓存的IP数据包（目标MAC=发送方MAC）
-        ethernet_out(cached_buf, arp_pkt->sender_mac, NET_PROTOCOL_IP);
+        ethernet_out_if(net_if_select(arp_pkt->sender_ip, NULL), cached_buf, arp_pkt->sender_mac, NET_PROTOCOL_IP);
         // 删除缓存，避免重复发送
         map_delete(&arp_buf, arp_pkt->sender_ip);
         return;
     }
     // 情况2：无缓存 → 判断是否是请求本机MAC的ARP_REQUEST
-    // 条件1：操作类型是ARP_REQUEST；条件2：目标IP是本机IP
-    if (opcode == ARP_REQUEST && !memcmp(arp_pkt->target_ip, net_if_ip, NET_IP_LEN)) {
+    // 条件1：操作类型是ARP_REQUEST；条件2：目标IP是本机任一网卡上的地址
+    if (opcode == ARP_REQUEST && net_if_lookup(arp_pkt->target_ip) >= 0) {
         // 回应ARP响应报文
-        arp_resp(arp_pkt->sender_ip, arp_pkt->sender_mac);
+        arp_resp(arp_pkt->sender_ip, arp_pkt->sender_mac, arp_pkt->target_ip);
     }
 }
 
@@ -171,7 +172,7 @@ void arp_out(buf_t *buf, uint8_t *ip) {
     uint8_t *dst_mac = map_get(&arp_table, ip);
     //找到对应 MAC 地址：若能找到该IP地址对应的MAC地址，则将数据包直接发送给以太网层，即调用ethernet_out函数将数据包发出。
     if( dst_mac != NULL){
-        ethernet_out(buf, dst_mac, NET_PROTOCOL_IP);
+        ethernet_out_if(net_if_select(ip, NULL), buf, dst_mac, NET_PROTOCOL_IP);
         return;
     }
     //未找到对应mac地址
@@ -186,13 +187,26 @@ void arp_out(buf_t *buf, uint8_t *ip) {
     arp_req(ip);
 }
 
+/**
+ * @brief 查询arp表
+ *
+ * @param ip 要查询的ip地址
+ * @return uint8_t* 对应的mac地址，未解析为NULL
+ */
+uint8_t *arp_lookup(uint8_t *ip) {
+    return map_get(&arp_table, ip);
+}
+
 /**
  * @brief 初始化arp协议
  *
  */
 void arp_init() {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, NULL, buf_copy);
+    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, net_config.arp_max_num, net_config.arp_timeout_sec, NULL, NULL);
+    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, net_config.arp_min_interval_sec, NULL, buf_copy);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
-    arp_req(net_if_ip);
+    //为每块网卡上的每个地址发送无回报ARP
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr_num; j++)
+            arp_req(net_ifs[i].addrs[j].ip);
 }
\ No newline at end of file
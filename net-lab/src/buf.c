@@ -97,6 +97,7 @@ int buf_remove_padding(buf_t *buf, size_t len) {
 void buf_copy(void *pdst, const void *psrc, size_t len) {
     buf_t *dst = pdst;
     const buf_t *src = psrc;
-    buf_init(dst, src->len);
+    dst->len = src->len;
+    dst->data = dst->payload + (src->data - src->payload);
     memcpy(dst->payload, src->payload, BUF_MAX_LEN);
 }
@@ -0,0 +1,23 @@
+#include "utils.h"
+
+/**
+ * @brief 获取毫秒级时钟，用于协议栈中需要亚秒精度的计时器
+ *
+ * @return uint64_t 当前时间（毫秒）
+ */
+uint64_t clock_ms() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief 获取微秒级时钟
+ *
+ * @return uint64_t 当前时间（微秒）
+ */
+uint64_t clock_us() {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,396 @@
+#include "config.h"
+
+#include "ip.h"
+#include "net.h"
+#include "tcp.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 运行时配置，默认值取自编译期的宏
+ *
+ */
+net_config_t net_config = {
+    .netmask = NET_IF_MASK,
+    .gateway = NET_IF_GATEWAY,
+    .mtu = IP_MTU,
+    .ttl = IP_DEFAULT_TTL,
+    .arp_timeout_sec = ARP_TIMEOUT_SEC,
+    .arp_min_interval_sec = ARP_MIN_INTERVAL,
+    .ip_reasm_timeout_ms = IP_REASM_TIMEOUT_MS,
+    .ip_reasm_mem_limit = IP_REASM_MEM_LIMIT,
+    .ip_pmtu_timeout_sec = IP_PMTU_TIMEOUT_SEC,
+    .ip_pmtu_max_num = IP_PMTU_MAX_NUM,
+    .ip_dst_cache_timeout_sec = IP_DST_CACHE_TIMEOUT_SEC,
+    .tcp_max_conn_num = TCP_MAX_CONN_NUM,
+    .tcp_max_buf_num = TCP_BUF_POOL_NUM,
+    .tcp_syn_cookie_threshold = TCP_SYN_COOKIE_THRESHOLD,
+    .tcp_syn_backlog = TCP_SYN_BACKLOG,
+    .tcp_accept_backlog = TCP_ACCEPT_BACKLOG,
+    .tcp_time_wait_ms = TCP_TIME_WAIT_MS,
+    .tcp_data_retries = TCP_DATA_RETRIES,
+};
+
+typedef enum net_config_type {
+    NET_CONFIG_U32,   // 无符号整数，限定在 [min, max] 内
+    NET_CONFIG_STR,   // 字符串，长度不超过 max
+    NET_CONFIG_IP,    // 点分十进制ip地址
+    NET_CONFIG_MAC,   // 冒号分隔的mac地址
+    NET_CONFIG_ADDR,  // 形如 ip/前缀长度 的从地址，可重复出现
+    NET_CONFIG_GROUP, // 启动时加入的组播地址，可重复出现
+    NET_CONFIG_IP6,   // 冒号分隔的ipv6地址
+    NET_CONFIG_ADDR6, // 形如 ipv6地址/前缀长度 的ipv6地址，可重复出现
+} net_config_type_t;
+
+typedef struct net_config_opt {  // 一个配置项
+    const char *name;        // 配置文件中的键，命令行中为 --键
+    net_config_type_t type;  // 值的类型
+    void *value;             // 值的存放位置
+    uint32_t min;            // 整数的下限
+    uint32_t max;            // 整数的上限或字符串的最大长度
+    const char *help;        // 说明
+} net_config_opt_t;
+
+/**
+ * @brief 配置项表
+ *
+ */
+static const net_config_opt_t net_config_opts[] = {
+    {"interface", NET_CONFIG_STR, net_config.if_name, 0, NET_IF_NAME_LEN - 1, "主网卡名，缺省时按主地址选择"},
+    {"ip", NET_CONFIG_IP, net_if_ip, 0, 0, "主地址"},
+    {"netmask", NET_CONFIG_IP, net_config.netmask, 0, 0, "主地址的子网掩码"},
+    {"gateway", NET_CONFIG_IP, net_config.gateway, 0, 0, "默认网关"},
+    {"mac", NET_CONFIG_MAC, net_if_mac, 0, 0, "主网卡mac地址"},
+    {"addr", NET_CONFIG_ADDR, NULL, 0, 0, "主网卡上的从地址，形如 ip/前缀长度，可重复"},
+    {"addr6", NET_CONFIG_ADDR6, NULL, 0, 0, "主网卡上的ipv6地址，形如 ipv6地址/前缀长度，可重复"},
+    {"gateway6", NET_CONFIG_IP6, net_config.gateway6, 0, 0, "ipv6默认网关"},
+    {"mcast_group", NET_CONFIG_GROUP, NULL, 0, 0, "启动时主网卡加入的组播组，可重复"},
+    {"mtu", NET_CONFIG_U32, &net_config.mtu, IP_PMTU_MIN, IP_MTU, "链路MTU"},
+    {"ttl", NET_CONFIG_U32, &net_config.ttl, 1, UINT8_MAX, "发出数据报的TTL"},
+    {"arp_timeout_sec", NET_CONFIG_U32, &net_config.arp_timeout_sec, 1, UINT32_MAX, "arp表项的有效期（秒）"},
+    {"arp_min_interval_sec", NET_CONFIG_U32, &net_config.arp_min_interval_sec, 1, UINT32_MAX, "向相同地址发送arp请求的最小间隔（秒）"},
+    {"arp_max_num", NET_CONFIG_U32, &net_config.arp_max_num, 0, UINT32_MAX, "arp表最大条目数，0为按map容量"},
+    {"ip_reasm_timeout_ms", NET_CONFIG_U32, &net_config.ip_reasm_timeout_ms, 1, UINT32_MAX, "分片重组超时时间（毫秒）"},
+    {"ip_reasm_mem_limit", NET_CONFIG_U32, &net_config.ip_reasm_mem_limit, 0, IP_REASM_POOL_NUM * IP_REASM_CHUNK_LEN, "重组缓存块总字节数上限"},
+    {"ip_pmtu_timeout_sec", NET_CONFIG_U32, &net_config.ip_pmtu_timeout_sec, 1, UINT32_MAX, "路径MTU缓存的有效期（秒）"},
+    {"ip_pmtu_max_num", NET_CONFIG_U32, &net_config.ip_pmtu_max_num, 1, UINT32_MAX, "路径MTU缓存的最大条目数"},
+    {"ip_dst_cache_timeout_sec", NET_CONFIG_U32, &net_config.ip_dst_cache_timeout_sec, 0, UINT32_MAX, "目的地址缓存项的有效期（秒），0为关闭缓存"},
+    {"tcp_max_conn_num", NET_CONFIG_U32, &net_config.tcp_max_conn_num, 1, TCP_MAX_CONN_NUM, "TCP连接数上限"},
+    {"tcp_max_buf_num", NET_CONFIG_U32, &net_config.tcp_max_buf_num, 1, TCP_BUF_POOL_NUM, "TCP收发缓冲区数上限"},
+    {"tcp_syn_cookie_threshold", NET_CONFIG_U32, &net_config.tcp_syn_cookie_threshold, 0, UINT32_MAX, "全局半连接数达到该值后改用 SYN cookie 应答"},
+    {"tcp_syn_backlog", NET_CONFIG_U32, &net_config.tcp_syn_backlog, 0, UINT32_MAX, "监听者默认的半连接队列长度"},
+    {"tcp_accept_backlog", NET_CONFIG_U32, &net_config.tcp_accept_backlog, 0, UINT32_MAX, "监听者默认的已建立连接数上限"},
+    {"tcp_time_wait_ms", NET_CONFIG_U32, &net_config.tcp_time_wait_ms, 0, UINT32_MAX, "TIME_WAIT 状态的持续时间（毫秒）"},
+    {"tcp_data_retries", NET_CONFIG_U32, &net_config.tcp_data_retries, 1, UINT8_MAX, "数据的最大连续超时重传次数"},
+};
+
+#define NET_CONFIG_OPT_NUM (sizeof(net_config_opts) / sizeof(net_config_opts[0]))
+
+/**
+ * @brief 解析点分十进制ip地址
+ *
+ * @param str 要解析的字符串
+ * @param ip 出口参数，解析出的地址
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_ip(const char *str, uint8_t *ip) {
+    unsigned int b[NET_IP_LEN];
+    char tail;
+    if (sscanf(str, "%u.%u.%u.%u%c", &b[0], &b[1], &b[2], &b[3], &tail) != NET_IP_LEN)
+        return -1;
+    for (int i = 0; i < NET_IP_LEN; i++) {
+        if (b[i] > UINT8_MAX)
+            return -1;
+        ip[i] = b[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析冒号分隔的ipv6地址，支持以 :: 省略连续的全0分组，不支持内嵌的ipv4地址
+ *
+ * @param str 要解析的字符串
+ * @param ip 出口参数，解析出的地址
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_ip6(const char *str, uint8_t *ip) {
+    uint16_t words[8];
+    int num = 0, gap = -1;
+    const char *p = str;
+    if (p[0] == ':' && p[1] == ':') {
+        gap = 0;
+        p += 2;
+    }
+    while (*p) {
+        char *end;
+        unsigned long v = strtoul(p, &end, 16);
+        if (end == p || end - p > 4 || v > UINT16_MAX || num == 8)
+            return -1;
+        words[num++] = v;
+        p = end;
+        if (*p == '\0')
+            break;
+        if (*p != ':')
+            return -1;
+        p++;
+        if (*p == ':') {
+            if (gap >= 0)
+                return -1;  // 只能有一个 ::
+            gap = num;
+            p++;
+        } else if (*p == '\0') {
+            return -1;
+        }
+    }
+    if (gap < 0 ? num != 8 : num > 7)
+        return -1;
+    memset(ip, 0, NET_IP6_LEN);
+    for (int i = 0; i < num; i++) {
+        int pos = (gap >= 0 && i >= gap) ? i + 8 - num : i;
+        ip[2 * pos] = words[i] >> 8;
+        ip[2 * pos + 1] = words[i] & 0xff;
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析形如 ipv6地址/前缀长度 的ipv6地址并加入配置
+ *
+ * @param str 要解析的字符串
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_addr6(const char *str) {
+    char ip_str[NET_CONFIG_LINE_LEN];
+    unsigned int prefix_len;
+    char tail;
+    if (net_config.addr6_num == NET_CONFIG_ADDR6_MAX_NUM)
+        return -1;
+    if (sscanf(str, "%255[0-9a-fA-F:]/%u%c", ip_str, &prefix_len, &tail) != 2 || prefix_len > 128)
+        return -1;
+    net_if_addr6_t *addr = &net_config.addrs6[net_config.addr6_num];
+    if (net_config_parse_ip6(ip_str, addr->ip) < 0)
+        return -1;
+    addr->prefix_len = prefix_len;
+    net_config.addr6_num++;
+    return 0;
+}
+
+/**
+ * @brief 解析冒号分隔的mac地址
+ *
+ * @param str 要解析的字符串
+ * @param mac 出口参数，解析出的地址
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_mac(const char *str, uint8_t *mac) {
+    unsigned int b[NET_MAC_LEN];
+    char tail;
+    if (sscanf(str, "%x:%x:%x:%x:%x:%x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &tail) != NET_MAC_LEN)
+        return -1;
+    for (int i = 0; i < NET_MAC_LEN; i++) {
+        if (b[i] > UINT8_MAX)
+            return -1;
+        mac[i] = b[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief 解析形如 ip/前缀长度 的从地址并加入配置
+ *
+ * @param str 要解析的字符串
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_addr(const char *str) {
+    char ip_str[NET_CONFIG_LINE_LEN];
+    unsigned int prefix_len;
+    char tail;
+    if (net_config.addr_num == NET_CONFIG_ADDR_MAX_NUM)
+        return -1;
+    if (sscanf(str, "%255[0-9.]/%u%c", ip_str, &prefix_len, &tail) != 2 || prefix_len > 32)
+        return -1;
+    net_if_addr_t *addr = &net_config.addrs[net_config.addr_num];
+    if (net_config_parse_ip(ip_str, addr->ip) < 0)
+        return -1;
+    uint32_t mask = prefix_len ? UINT32_MAX << (32 - prefix_len) : 0;
+    for (int i = 0; i < NET_IP_LEN; i++)
+        addr->netmask[i] = mask >> (8 * (NET_IP_LEN - 1 - i));
+    net_config.addr_num++;
+    return 0;
+}
+
+/**
+ * @brief 解析启动时加入的组播地址并加入配置
+ *
+ * @param str 要解析的字符串
+ * @return int 成功为0，失败为-1
+ */
+static int net_config_parse_group(const char *str) {
+    uint8_t *group = net_config.groups[net_config.group_num];
+    if (net_config.group_num == NET_IF_GROUP_MAX_NUM || net_config_parse_ip(str, group) < 0 || (group[0] & 0xf0) != 0xe0)
+        return -1;
+    net_config.group_num++;
+    return 0;
+}
+
+/**
+ * @brief 设置一个配置项
+ *
+ * @param name 配置项的键
+ * @param value 配置项的值
+ * @return int 成功为0，键不存在或值不合法为-1
+ */
+static int net_config_set(const char *name, const char *value) {
+    const net_config_opt_t *opt = NULL;
+    for (size_t i = 0; i < NET_CONFIG_OPT_NUM && !opt; i++)
+        if (!strcmp(net_config_opts[i].name, name))
+            opt = &net_config_opts[i];
+    if (!opt) {
+        fprintf(stderr, "Unknown config option %s.\n", name);
+        return -1;
+    }
+    int ret = 0;
+    switch (opt->type) {
+        case NET_CONFIG_U32: {
+            char *end;
+            unsigned long long v = strtoull(value, &end, 0);
+            if (*value == '\0' || *value == '-' || *end != '\0' || v < opt->min || v > opt->max)
+                ret = -1;
+            else
+                *(uint32_t *)opt->value = v;
+            break;
+        }
+        case NET_CONFIG_STR:
+            if (strlen(value) > opt->max)
+                ret = -1;
+            else
+                strcpy(opt->value, value);
+            break;
+        case NET_CONFIG_IP:
+            ret = net_config_parse_ip(value, opt->value);
+            break;
+        case NET_CONFIG_MAC:
+            ret = net_config_parse_mac(value, opt->value);
+            break;
+        case NET_CONFIG_ADDR:
+            ret = net_config_parse_addr(value);
+            break;
+        case NET_CONFIG_GROUP:
+            ret = net_config_parse_group(value);
+            break;
+        case NET_CONFIG_IP6:
+            ret = net_config_parse_ip6(value, opt->value);
+            break;
+        case NET_CONFIG_ADDR6:
+            ret = net_config_parse_addr6(value);
+            break;
+    }
+    if (ret < 0)
+        fprintf(stderr, "Invalid value %s for config option %s.\n", value, name);
+    return ret;
+}
+
+/**
+ * @brief 去掉字符串首尾的空白字符
+ *
+ */
+static char *net_config_trim(char *str) {
+    while (isspace((unsigned char)*str))
+        str++;
+    char *end = str + strlen(str);
+    while (end > str && isspace((unsigned char)end[-1]))
+        *--end = '\0';
+    return str;
+}
+
+/**
+ * @brief 读取配置文件，每行一个 键 = 值，# 之后为注释，须在 net_init() 之前调用
+ *
+ * @param path 配置文件路径
+ * @return int 成功为0，失败为-1
+ */
+int net_config_load(const char *path) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Failed to open config file %s.\n", path);
+        return -1;
+    }
+    char line[NET_CONFIG_LINE_LEN];
+    int line_no = 0, ret = 0;
+    while (ret == 0 && fgets(line, sizeof(line), f)) {
+        line_no++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = '\0';
+        char *key = net_config_trim(line);
+        if (*key == '\0')
+            continue;
+        char *eq = strchr(key, '=');
+        if (!eq) {
+            fprintf(stderr, "Expected key = value.\n");
+            ret = -1;
+        } else {
+            *eq = '\0';
+            ret = net_config_set(net_config_trim(key), net_config_trim(eq + 1));
+        }
+        if (ret < 0)
+            fprintf(stderr, "Error in %s:%d.\n", path, line_no);
+    }
+    fclose(f);
+    return ret;
+}
+
+/**
+ * @brief 打印命令行用法
+ *
+ */
+static void net_config_usage(const char *prog) {
+    printf("Usage: %s [-c config_file] [--key=value ...]\n", prog);
+    for (size_t i = 0; i < NET_CONFIG_OPT_NUM; i++)
+        printf("  --%-26s %s\n", net_config_opts[i].name, net_config_opts[i].help);
+}
+
+/**
+ * @brief 解析命令行参数：-c/--config 读取配置文件，--键=值 或 --键 值 覆盖单个配置项，按出现顺序生效
+ *
+ * @param argc 参数个数
+ * @param argv 参数
+ * @return int 成功为0，失败为-1，打印了用法（-h/--help）为1
+ */
+int net_config_parse_args(int argc, char const *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            net_config_usage(argv[0]);
+            return 1;
+        }
+        if (!strcmp(arg, "-c") || !strcmp(arg, "--config")) {
+            if (i + 1 == argc || net_config_load(argv[++i]) < 0)
+                return -1;
+            continue;
+        }
+        if (strncmp(arg, "--", 2)) {
+            fprintf(stderr, "Unexpected argument %s.\n", arg);
+            return -1;
+        }
+        char name[NET_CONFIG_LINE_LEN];
+        const char *value;
+        const char *eq = strchr(arg, '=');
+        if (eq) {
+            snprintf(name, sizeof(name), "%.*s", (int)(eq - arg - 2), arg + 2);
+            value = eq + 1;
+        } else if (i + 1 < argc) {
+            snprintf(name, sizeof(name), "%s", arg + 2);
+            value = argv[++i];
+        } else {
+            fprintf(stderr, "Missing value for %s.\n", arg);
+            return -1;
+        }
+        if (net_config_set(name, value) < 0)
+            return -1;
+    }
+    return 0;
+}
@@ -26,7 +26,16 @@ BOOL LoadNpcapDlls() {
 }
 #endif
 
-pcap_t *pcap;
+/**
+ * @brief 每块网卡的pcap句柄，下标为网卡编号
+ *
+ */
+static pcap_t *pcaps[NET_IF_MAX_NUM];
+/**
+ * @brief 每块网卡的子网掩码，编译过滤器时使用
+ *
+ */
+static uint32_t pcap_masks[NET_IF_MAX_NUM];
 char pcap_errbuf[PCAP_ERRBUF_SIZE];
 
 /**
@@ -74,7 +83,7 @@ int driver_find(uint8_t *ip, char *if_name, uint8_t *mask) {
     for (d = alldevs, i = 0; i < max_if; d = d->next, i++)
         ;
     if (max_match == 32) {
-        fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", d->name, iptos(net_if_ip));
+        fprintf(stderr, "Error, interface %s have the same ip %s with me.\n", d->name, iptos(ip));
         return -1;
     }
     for (a = d->addresses; a; a = a->next)
@@ -86,71 +95,126 @@ int driver_find(uint8_t *ip, char *if_name, uint8_t *mask) {
 }
 
 /**
- * @brief 打开网卡
+ * @brief mac地址转为过滤表达式中的 xx:xx:xx:xx:xx:xx 形式
  *
- * @return int 成功为0，失败为-1
  */
-int driver_open() {
-#ifdef _WIN32
-    /* Load Npcap and its functions. */
-    if (!LoadNpcapDlls()) {
-        fprintf(stderr, "Couldn't load Npcap\n");
+static char *driver_mac_str(const uint8_t *mac, char *out) {
+    sprintf(out, "%02x:%02x:%02x:%02x:%02x:%02x", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    return out;
+}
+
+/**
+ * @brief 按网卡表为网卡设置过滤器：本网卡mac地址、广播地址，以及已加入的组播组的mac地址
+ *
+ * @param ifindex 网卡编号
+ * @return int 成功为0，网卡尚未打开时什么也不做，失败为-1
+ */
+int driver_update_filter(int ifindex) {
+    pcap_t *pcap = pcaps[ifindex];
+    if (pcap == NULL)
+        return 0;
+    net_if_t *nif = &net_ifs[ifindex];
+    char filter_exp[PCAP_BUF_SIZE];
+    char mac_str[3 * NET_MAC_LEN];
+    struct bpf_program fp;
+    int len = sprintf(filter_exp, "(ether dst %s or ether broadcast", driver_mac_str(nif->mac, mac_str));
+    if (nif->allmulti) {
+        len += sprintf(filter_exp + len, " or ether multicast");
+    } else {
+        uint8_t all_hosts[NET_IP_LEN] = {224, 0, 0, 1};
+        uint8_t group_mac[NET_MAC_LEN];
+        net_if_group_mac(all_hosts, group_mac);
+        len += sprintf(filter_exp + len, " or ether dst %s", driver_mac_str(group_mac, mac_str));
+        for (int i = 0; i < nif->group_num; i++) {
+            net_if_group_mac(nif->groups[i], group_mac);
+            len += sprintf(filter_exp + len, " or ether dst %s", driver_mac_str(group_mac, mac_str));
+        }
+#ifdef IPV6
+        // ipv6的所有节点组与各地址的请求节点组
+        len += sprintf(filter_exp + len, " or ether dst 33:33:00:00:00:01");
+        uint8_t group6[NET_IP6_LEN];
+        for (int i = 0; i < nif->addr6_num; i++) {
+            net_if_solicited_node(nif->addrs6[i].ip, group6);
+            net_if_group_mac6(group6, group_mac);
+            len += sprintf(filter_exp + len, " or ether dst %s", driver_mac_str(group_mac, mac_str));
+        }
+#endif
+    }
+    sprintf(filter_exp + len, ") and (not ether src %s)", driver_mac_str(nif->mac, mac_str));  // 过滤数据包
+    if (pcap_compile(pcap, &fp, filter_exp, 0, pcap_masks[ifindex]) < 0) {
+        fprintf(stderr, "Error in pcap_compile.\n%s.\n", pcap_geterr(pcap));
         return -1;
     }
-#endif
+    int ret = pcap_setfilter(pcap, &fp);
+    pcap_freecode(&fp);
+    if (ret < 0) {
+        fprintf(stderr, "Error in pcap_setfilter.\n%s.\n", pcap_geterr(pcap));
+        return -1;
+    }
+    return 0;
+}
 
+/**
+ * @brief 打开一块网卡
+ *
+ * @param ifindex 网卡编号
+ * @return int 成功为0，失败为-1
+ */
+static int driver_open_if(int ifindex) {
+    net_if_t *nif = &net_ifs[ifindex];
     char if_name[PCAP_BUF_SIZE];
-    uint32_t mask;
-    if (driver_find(net_if_ip, if_name, (uint8_t *)&mask) < 0) {
+    uint32_t mask = PCAP_NETMASK_UNKNOWN;
+    if (nif->name[0]) {
+        strcpy(if_name, nif->name);
+    } else if (driver_find(nif->addrs[0].ip, if_name, (uint8_t *)&mask) < 0) {
         fprintf(stderr, "Error in driver find.\n");
         return -1;
     }
-    printf("Using interface %s, my ip is %s.\n", if_name, iptos(net_if_ip));
+    printf("Using interface %s, my ip is %s.\n", if_name, iptos(nif->addrs[0].ip));
 
+    pcap_t *pcap;
     if ((pcap = pcap_open_live(if_name, 65536, 1, 10, pcap_errbuf)) == NULL)  // 混杂模式打开网卡
     {
         fprintf(stderr, "Error in pcap_open_live.\n%s.\n", pcap_errbuf);
         return -1;
     }
+    pcaps[ifindex] = pcap;
     if (pcap_setnonblock(pcap, 1, pcap_errbuf) < 0)  // 设置非阻塞模式
     {
         fprintf(stderr, "Error in pcap_setnonblock. %s.\n", pcap_errbuf);
         return -1;
     }
-    char filter_exp[PCAP_BUF_SIZE];
-    struct bpf_program fp;
-    uint8_t mac_addr[6] = NET_IF_MAC;
-    sprintf(filter_exp,  // 过滤数据包
-            "(ether dst %02x:%02x:%02x:%02x:%02x:%02x or ether broadcast) and (not ether src %02x:%02x:%02x:%02x:%02x:%02x)",
-            mac_addr[0],
-            mac_addr[1],
-            mac_addr[2],
-            mac_addr[3],
-            mac_addr[4],
-            mac_addr[5],
-            mac_addr[0],
-            mac_addr[1],
-            mac_addr[2],
-            mac_addr[3],
-            mac_addr[4],
-            mac_addr[5]);
-    if (pcap_compile(pcap, &fp, filter_exp, 0, mask) < 0) {
-        fprintf(stderr, "Error in pcap_compile.\n%s.\n", pcap_geterr(pcap));
-        return -1;
-    }
-    if (pcap_setfilter(pcap, &fp) < 0) {
-        fprintf(stderr, "Error in pcap_setfilter.\n%s.\n", pcap_geterr(pcap));
+    pcap_masks[ifindex] = mask;
+    return driver_update_filter(ifindex);
+}
+
+/**
+ * @brief 打开网卡表中的所有网卡
+ *
+ * @return int 成功为0，失败为-1
+ */
+int driver_open() {
+#ifdef _WIN32
+    /* Load Npcap and its functions. */
+    if (!LoadNpcapDlls()) {
+        fprintf(stderr, "Couldn't load Npcap\n");
         return -1;
     }
+#endif
+    for (int i = 0; i < net_if_num; i++)
+        if (driver_open_if(i) < 0)
+            return -1;
     return 0;
 }
 /**
- * @brief 试图从网卡接收数据包
+ * @brief 试图从一块网卡接收数据包
  *
+ * @param ifindex 网卡编号
  * @param buf 收到的数据包
  * @return int 数据包的长度，未收到为0，错误为-1
  */
-int driver_recv(buf_t *buf) {
+int driver_recv_if(int ifindex, buf_t *buf) {
+    pcap_t *pcap = pcaps[ifindex];
     struct pcap_pkthdr *pkt_hdr;
     const uint8_t *pkt_data;
     int ret = pcap_next_ex(pcap, &pkt_hdr, &pkt_data);
@@ -165,12 +229,23 @@ int driver_recv(buf_t *buf) {
     return -1;
 }
 /**
- * @brief 使用网卡发送一个数据包
+ * @brief 试图从主网卡接收数据包
+ *
+ * @param buf 收到的数据包
+ * @return int 数据包的长度，未收到为0，错误为-1
+ */
+int driver_recv(buf_t *buf) {
+    return driver_recv_if(0, buf);
+}
+/**
+ * @brief 使用一块网卡发送一个数据包
  *
+ * @param ifindex 网卡编号
  * @param buf 要发送的数据包
  * @return int 成功为0，失败为-1
  */
-int driver_send(buf_t *buf) {
+int driver_send_if(int ifindex, buf_t *buf) {
+    pcap_t *pcap = pcaps[ifindex];
     if (pcap_sendpacket(pcap, buf->data, buf->len) == -1) {
         fprintf(stderr, "Error in driver_send.\n%s.\n", pcap_geterr(pcap));
         return -1;
@@ -179,9 +254,22 @@ int driver_send(buf_t *buf) {
     return 0;
 }
 /**
- * @brief 关闭网卡
+ * @brief 使用主网卡发送一个数据包
+ *
+ * @param buf 要发送的数据包
+ * @return int 成功为0，失败为-1
+ */
+int driver_send(buf_t *buf) {
+    return driver_send_if(0, buf);
+}
+/**
+ * @brief 关闭所有网卡
  *
  */
 void driver_close() {
-    pcap_close(pcap);
+    for (int i = 0; i < net_if_num; i++)
+        if (pcaps[i]) {
+            pcap_close(pcaps[i]);
+            pcaps[i] = NULL;
+        }
 }
@@ -15,6 +15,9 @@ void ethernet_in(buf_t *buf) {
         return;//丢弃无效帧
     //解析以太网头部
     ether_hdr_t *ehdr = (ether_hdr_t*) buf -> data;
+    //丢弃不是发往本网卡、广播地址或已加入的组播组的帧
+    if (!net_if_mac_accept(net_if_rx, ehdr->dst))
+        return;
     //保存源mac地址
     uint8_t src_mac[6];
     for (int i = 0; i < 6; i++) {
@@ -28,13 +31,14 @@ void ethernet_in(buf_t *buf) {
     net_in(buf,protocol,src_mac);
 }
 /**
- * @brief 处理一个要发送的数据包
+ * @brief 处理一个要从指定网卡发送的数据包
  *
+ * @param ifindex 网卡编号
  * @param buf 要处理的数据包
  * @param mac 目标MAC地址
  * @param protocol 上层协议
  */
-void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol) {
+void ethernet_out_if(int ifindex, buf_t *buf, const uint8_t *mac, net_protocol_t protocol) {
     //如果长度不到46字节，则填充0
     if(buf->len < ETHERNET_MIN_TRANSPORT_UNIT){
         buf_add_padding(buf , ETHERNET_MIN_TRANSPORT_UNIT - buf->len);
@@ -48,12 +52,39 @@ void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol) {
     }
     //填写源mac地址
     for(int i = 0 ;i < 6 ; i++){
-        hdr->src[i] = net_if_mac[i];
+        hdr->src[i] = net_ifs[ifindex].mac[i];
     }
     //填写protocol
     hdr->protocol16 = swap16(protocol);
     //调用驱动层函数发送完整的以太网帧
-    driver_send(buf);
+    driver_send_if(ifindex, buf);
+}
+/**
+ * @brief 处理一个要从主网卡发送的数据包
+ *
+ * @param buf 要处理的数据包
+ * @param mac 目标MAC地址
+ * @param protocol 上层协议
+ */
+void ethernet_out(buf_t *buf, const uint8_t *mac, net_protocol_t protocol) {
+    ethernet_out_if(0, buf, mac, protocol);
+}
+/**
+ * @brief 以预先填好的以太网包头发送一个数据包
+ *
+ * @param ifindex 网卡编号
+ * @param buf 要处理的数据包
+ * @param hdr 以太网包头模板
+ */
+void ethernet_out_prebuilt(int ifindex, buf_t *buf, const ether_hdr_t *hdr) {
+    //如果长度不到46字节，则填充0
+    if (buf->len < ETHERNET_MIN_TRANSPORT_UNIT) {
+        buf_add_padding(buf, ETHERNET_MIN_TRANSPORT_UNIT - buf->len);
+    }
+    //添加以太网包头，整体拷贝模板
+    buf_add_header(buf, sizeof(ether_hdr_t));
+    memcpy(buf->data, hdr, sizeof(ether_hdr_t));
+    driver_send_if(ifindex, buf);
 }
 /**
  * @brief 初始化以太网协议
@@ -68,6 +99,11 @@ void ethernet_init() {
  *
  */
 void ethernet_poll() {
-    if (driver_recv(&rxbuf) > 0)
-        ethernet_in(&rxbuf);
+    for (int i = 0; i < net_if_num; i++) {
+        if (driver_recv_if(i, &rxbuf) > 0) {
+            net_if_rx = i;
+            ethernet_in(&rxbuf);
+        }
+    }
+    net_if_rx = 0;
 }
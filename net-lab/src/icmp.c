@@ -27,8 +27,43 @@ static void icmp_resp(buf_t *req_buf, uint8_t *src_ip) {
     icmp_hdr->checksum16 = checksum16((uint16_t *)txbuf.data, txbuf.len);
 
     // Step3: 发送数据报 
-    // 调用ip_out发送ICMP响应，目标IP为请求方IP，上层协议为ICMP
-    ip_out(&txbuf, src_ip, NET_PROTOCOL_ICMP);
+    // 调用ip_out_src发送ICMP响应，源IP为收到请求的本机地址，目标IP为请求方IP，上层协议为ICMP
+    ip_out_src(&txbuf, ip_in_dst, src_ip, NET_PROTOCOL_ICMP);
+}
+
+/**
+ * @brief RFC 1191 中的 MTU 平台值，路由器未通告下一跳MTU时据此逐级降低路径MTU
+ *
+ */
+static const uint16_t icmp_mtu_plateaus[] = {1492, 1006, 508, 296, 68};
+
+/**
+ * @brief 处理icmp需要分片报文，更新到原数据报目的地址的路径MTU
+ *
+ * @param buf 收到的icmp报文，数据部分为原数据报的IP头部及载荷前8字节
+ */
+static void icmp_frag_needed(buf_t *buf) {
+    if (buf->len < sizeof(icmp_hdr_t) + IP_MIN_HDR_LEN) {
+        return;
+    }
+    icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)buf->data;
+    ip_hdr_t *orig_hdr = (ip_hdr_t *)(buf->data + sizeof(icmp_hdr_t));
+    // 只接受针对本机发出的数据报的通告
+    if (net_if_lookup(orig_hdr->src_ip) < 0) {
+        return;
+    }
+    uint16_t mtu = swap16(icmp_hdr->seq16);
+    uint16_t orig_len = swap16(orig_hdr->total_len16);
+    // 旧式路由器不填写下一跳MTU，取低于原数据报长度的第一个平台值
+    if (mtu == 0 || mtu >= orig_len) {
+        mtu = 0;
+        for (size_t i = 0; i < sizeof(icmp_mtu_plateaus) / sizeof(icmp_mtu_plateaus[0]) && !mtu; i++)
+            if (icmp_mtu_plateaus[i] < orig_len)
+                mtu = icmp_mtu_plateaus[i];
+        if (!mtu)
+            return;
+    }
+    ip_pmtu_update(orig_hdr->dst_ip, mtu);
 }
 
 /**
@@ -46,10 +81,17 @@ void icmp_in(buf_t *buf, uint8_t *src_ip) {
     // 解析ICMP头部
     icmp_hdr_t *icmp_hdr = (icmp_hdr_t *)buf->data;
 
-    // Step2: 查看ICMP类型 仅处理回显请求（ICMP_TYPE_ECHO_REQUEST = 8）类型的报文
+    // Step2: 查看ICMP类型 处理需要分片报文与回显请求（ICMP_TYPE_ECHO_REQUEST = 8）
+    if (icmp_hdr->type == ICMP_TYPE_UNREACH && icmp_hdr->code == ICMP_CODE_FRAG_NEEDED) {
+        icmp_frag_needed(buf);
+        return;
+    }
     if (icmp_hdr->type != ICMP_TYPE_ECHO_REQUEST) {
         return; // 非回显请求，无需处理
     }
+    if (net_if_lookup(ip_in_dst) < 0) {
+        return; // 不应答发往广播或组播地址的回显请求
+    }
     // Step3: 回送回显应答 调用icmp_resp发送回显响应，传入请求包和源IP（响应目标为请求方IP）
     icmp_resp(buf, src_ip);
 }
@@ -62,6 +104,12 @@ void icmp_in(buf_t *buf, uint8_t *src_ip) {
  * @param code icmp code，协议不可达或端口不可达
  */
 void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code) {
+    // 不为发往广播或组播地址的数据报发送差错报文，应答的源IP为原IP包的目的地址
+    uint8_t dst_ip[NET_IP_LEN];
+    memcpy(dst_ip, ((ip_hdr_t *)recv_buf->data)->dst_ip, NET_IP_LEN);
+    if (net_if_lookup(dst_ip) < 0) {
+        return;
+    }
     // Step1: 初始化并填写ICMP报头 
     // 1. 计算ICMP报文总长度：ICMP头(8字节) + IP头(至少20字节) + IP载荷前8字节
     size_t ip_hdr_len = ((ip_hdr_t *)recv_buf->data)->hdr_len * IP_HDR_LEN_PER_BYTE; // 实际IP头长度
@@ -94,8 +142,8 @@ void icmp_unreachable(buf_t *recv_buf, uint8_t *src_ip, icmp_code_t code) {
     // 2. 计算整个ICMP报文的校验和（头部+数据）
     icmp_hdr->checksum16 = checksum16((uint16_t *)txbuf.data, txbuf.len);
     //  Step3: 发送数据报 
-    // 调用ip_out发送ICMP不可达报文，目标IP为原IP包的发送方，上层协议为ICMP
-    ip_out(&txbuf, src_ip, NET_PROTOCOL_ICMP);
+    // 调用ip_out_src发送ICMP不可达报文，目标IP为原IP包的发送方，上层协议为ICMP
+    ip_out_src(&txbuf, dst_ip, src_ip, NET_PROTOCOL_ICMP);
 }
 
 /**
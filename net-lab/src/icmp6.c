@@ -0,0 +1,100 @@
+#include "icmp6.h"
+
+#include "ip6.h"
+#include "nd.h"
+#include "net.h"
+
+/**
+ * @brief 发送icmpv6回显响应
+ *
+ * @param req_buf 收到的回显请求
+ * @param src_ip 源ipv6地址
+ */
+static void icmp6_resp(buf_t *req_buf, uint8_t *src_ip) {
+    buf_init(&txbuf, req_buf->len);
+    memcpy(txbuf.data, req_buf->data, req_buf->len);
+    icmp6_hdr_t *icmp6_hdr = (icmp6_hdr_t *)txbuf.data;
+    icmp6_hdr->type = ICMP6_TYPE_ECHO_REPLY;
+    icmp6_hdr->code = 0;
+    icmp6_hdr->checksum16 = 0;
+    // 应答的源地址为请求的目的地址，发往组播地址的请求由本机选择源地址
+    uint8_t src[NET_IP6_LEN];
+    if (net_if_lookup6(ip6_in_dst) >= 0)
+        memcpy(src, ip6_in_dst, NET_IP6_LEN);
+    else
+        ip6_src_select(src_ip, src);
+    icmp6_hdr->checksum16 = transport_checksum6(NET_PROTOCOL_ICMPV6, &txbuf, src, src_ip);
+    ip6_out(&txbuf, src, src_ip, NET_PROTOCOL_ICMPV6);
+}
+
+/**
+ * @brief 处理一个收到的icmpv6报文
+ *
+ * @param buf 要处理的数据包
+ * @param src_ip 源ipv6地址
+ */
+void icmp6_in(buf_t *buf, uint8_t *src_ip) {
+    // Step1: 检查长度与校验和，校验和含ipv6伪首部
+    if (buf->len < sizeof(icmp6_hdr_t))
+        return;
+    icmp6_hdr_t *icmp6_hdr = (icmp6_hdr_t *)buf->data;
+    uint16_t checksum = icmp6_hdr->checksum16;
+    icmp6_hdr->checksum16 = 0;
+    if (transport_checksum6(NET_PROTOCOL_ICMPV6, buf, src_ip, ip6_in_dst) != checksum)
+        return;
+    icmp6_hdr->checksum16 = checksum;
+
+    // Step2: 按类型分发，邻居发现报文交给nd处理
+    switch (icmp6_hdr->type) {
+        case ICMP6_TYPE_ECHO_REQUEST:
+            icmp6_resp(buf, src_ip);
+            break;
+        case ICMP6_TYPE_NEIGHBOR_SOLICIT:
+        case ICMP6_TYPE_NEIGHBOR_ADVERT:
+            nd_in(buf, src_ip);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief 发送icmpv6差错报文，在最小MTU允许的范围内尽量引用原数据报
+ *
+ * @param recv_buf 收到的ipv6数据包，含首部
+ * @param src_ip 源ipv6地址
+ * @param type 差错类型，目的不可达或参数问题
+ * @param code 差错代码
+ * @param param 参数问题中出错字段的偏移，目的不可达时为0
+ */
+void icmp6_error(buf_t *recv_buf, uint8_t *src_ip, icmp6_type_t type, icmp6_code_t code, uint32_t param) {
+    // 不为发往组播地址的数据报与icmpv6差错报文发送差错报文，应答的源地址为原数据报的目的地址
+    if (net_if_lookup6(ip6_in_dst) < 0)
+        return;
+    ip6_hdr_t *ip6_hdr = (ip6_hdr_t *)recv_buf->data;
+    if (ip6_hdr->next_header == NET_PROTOCOL_ICMPV6 && recv_buf->len > IP6_HDR_LEN &&
+        recv_buf->data[IP6_HDR_LEN] < ICMP6_TYPE_ECHO_REQUEST)
+        return;
+    uint8_t src[NET_IP6_LEN], dst[NET_IP6_LEN];
+    memcpy(src, ip6_in_dst, NET_IP6_LEN);
+    memcpy(dst, src_ip, NET_IP6_LEN);
+
+    size_t quote_len = recv_buf->len < ICMP6_ERROR_MAX_LEN ? recv_buf->len : ICMP6_ERROR_MAX_LEN;
+    buf_init(&txbuf, sizeof(icmp6_hdr_t) + quote_len);
+    icmp6_hdr_t *icmp6_hdr = (icmp6_hdr_t *)txbuf.data;
+    icmp6_hdr->type = type;
+    icmp6_hdr->code = code;
+    icmp6_hdr->checksum16 = 0;
+    icmp6_hdr->data32 = swap32(param);
+    memcpy(txbuf.data + sizeof(icmp6_hdr_t), recv_buf->data, quote_len);
+    icmp6_hdr->checksum16 = transport_checksum6(NET_PROTOCOL_ICMPV6, &txbuf, src, dst);
+    ip6_out(&txbuf, src, dst, NET_PROTOCOL_ICMPV6);
+}
+
+/**
+ * @brief 初始化icmpv6协议
+ *
+ */
+void icmp6_init() {
+    ip6_add_protocol(NET_PROTOCOL_ICMPV6, icmp6_in);
+}
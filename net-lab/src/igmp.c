@@ -0,0 +1,312 @@
+#include "igmp.h"
+
+#include "ip.h"
+#include "net.h"
+
+/**
+ * @brief 待发报告表
+ *
+ */
+static map_t igmp_timer_table;  // [ifindex, group] -> igmp_timer
+/**
+ * @brief 各网卡的IGMP状态
+ *
+ */
+static igmp_if_t igmp_ifs[NET_IF_MAX_NUM];
+
+static const uint8_t igmp_all_hosts[NET_IP_LEN] = {224, 0, 0, 1};     // 所有主机组，不发送报告
+static const uint8_t igmp_all_routers[NET_IP_LEN] = {224, 0, 0, 2};   // v2 离开报文的目的地址
+static const uint8_t igmp_v3_routers[NET_IP_LEN] = {224, 0, 0, 22};   // v3 报告的目的地址
+
+/**
+ * @brief 网卡当前应使用的IGMP版本，网段上有旧版本查询者时退回旧版本
+ *
+ */
+static int igmp_version(int ifindex) {
+    uint64_t now = clock_ms();
+    if (now < igmp_ifs[ifindex].v1_until)
+        return 1;
+    if (now < igmp_ifs[ifindex].v2_until)
+        return 2;
+    return 3;
+}
+
+/**
+ * @brief [0, max_ms] 内的随机延迟，使网段上各主机的应答错开
+ *
+ */
+static uint64_t igmp_random_delay(uint64_t max_ms) {
+    uint32_t r;
+    random_bytes((uint8_t *)&r, sizeof(r));
+    return max_ms ? r % (max_ms + 1) : 0;
+}
+
+/**
+ * @brief 填写校验和，以网卡的主地址为源地址发送txbuf中的IGMP报文
+ *
+ */
+static void igmp_send(int ifindex, const uint8_t *dst) {
+    igmp_hdr_t *hdr = (igmp_hdr_t *)txbuf.data;
+    hdr->checksum16 = 0;
+    hdr->checksum16 = checksum16((uint16_t *)txbuf.data, txbuf.len);
+    ip_out_router_alert(&txbuf, net_ifs[ifindex].addrs[0].ip, (uint8_t *)dst, NET_PROTOCOL_IGMP);
+}
+
+/**
+ * @brief 发送一个v1/v2报文：成员报告发往组播地址本身，离开报文发往所有路由器组
+ *
+ */
+static void igmp_send_v2(int ifindex, const uint8_t *group, uint8_t type) {
+    buf_init(&txbuf, sizeof(igmp_hdr_t));
+    igmp_hdr_t *hdr = (igmp_hdr_t *)txbuf.data;
+    hdr->type = type;
+    hdr->max_resp = 0;
+    memcpy(hdr->group, group, NET_IP_LEN);
+    igmp_send(ifindex, type == IGMP_TYPE_V2_LEAVE ? igmp_all_routers : group);
+}
+
+/**
+ * @brief 发送一个v3成员报告
+ *
+ * @param ifindex 网卡编号
+ * @param group 只报告该组，为NULL时报告网卡加入的所有组（应答通用查询）
+ * @param record_type 记录类型
+ */
+static void igmp_send_v3(int ifindex, const uint8_t *group, uint8_t record_type) {
+    net_if_t *nif = &net_ifs[ifindex];
+    buf_init(&txbuf, sizeof(igmp_v3_report_t) + NET_IF_GROUP_MAX_NUM * sizeof(igmp_v3_record_t));
+    igmp_v3_record_t *record = (igmp_v3_record_t *)(txbuf.data + sizeof(igmp_v3_report_t));
+    uint16_t record_num = 0;
+    for (int i = 0; i < (group ? 1 : nif->group_num); i++) {
+        const uint8_t *g = group ? group : nif->groups[i];
+        if (!memcmp(g, igmp_all_hosts, NET_IP_LEN))
+            continue;
+        record->type = record_type;
+        record->aux_len = 0;
+        record->src_num16 = 0;
+        memcpy(record->group, g, NET_IP_LEN);
+        record++;
+        record_num++;
+    }
+    if (record_num == 0)
+        return;
+    buf_remove_padding(&txbuf, (NET_IF_GROUP_MAX_NUM - record_num) * sizeof(igmp_v3_record_t));
+    igmp_v3_report_t *report = (igmp_v3_report_t *)txbuf.data;
+    report->type = IGMP_TYPE_V3_REPORT;
+    report->reserved = 0;
+    report->reserved16 = 0;
+    report->record_num16 = swap16(record_num);
+    igmp_send(ifindex, igmp_v3_routers);
+}
+
+/**
+ * @brief 按网卡当前的IGMP版本发送一个组的报告
+ *
+ */
+static void igmp_send_group(int ifindex, const uint8_t *group, uint8_t record_type) {
+    switch (igmp_version(ifindex)) {
+        case 1:
+            if (record_type != IGMP_CHANGE_TO_INCLUDE)  // v1 没有离开报文
+                igmp_send_v2(ifindex, group, IGMP_TYPE_V1_REPORT);
+            break;
+        case 2:
+            igmp_send_v2(ifindex, group, record_type == IGMP_CHANGE_TO_INCLUDE ? IGMP_TYPE_V2_LEAVE : IGMP_TYPE_V2_REPORT);
+            break;
+        default:
+            igmp_send_v3(ifindex, group, record_type);
+            break;
+    }
+}
+
+/**
+ * @brief 为一个组安排报告，已有未发完的状态变化报告或更早的查询应答时保留原有安排
+ *
+ * @param ifindex 网卡编号
+ * @param group 组播地址
+ * @param record_type 记录类型
+ * @param delay_ms 距发送的延迟
+ * @param count 发送次数
+ */
+static void igmp_schedule(int ifindex, const uint8_t *group, uint8_t record_type, uint64_t delay_ms, uint8_t count) {
+    igmp_key_t key = {ifindex};
+    memcpy(key.group, group, NET_IP_LEN);
+    igmp_timer_t timer = {clock_ms() + delay_ms, count, record_type};
+    igmp_timer_t *old = map_get(&igmp_timer_table, &key);
+    if (old && (old->record_type != IGMP_MODE_IS_EXCLUDE || old->due <= timer.due))
+        return;
+    map_set(&igmp_timer_table, &key, &timer);
+}
+
+/**
+ * @brief 组状态变化时立即发送一次报告，其余 IGMP_ROBUSTNESS - 1 次在随机延迟后重传
+ *
+ */
+static void igmp_state_change(int ifindex, const uint8_t *group, uint8_t record_type) {
+    if (!memcmp(group, igmp_all_hosts, NET_IP_LEN))
+        return;
+    igmp_send_group(ifindex, group, record_type);
+    igmp_key_t key = {ifindex};
+    memcpy(key.group, group, NET_IP_LEN);
+    map_delete(&igmp_timer_table, &key);
+    if (!(record_type == IGMP_CHANGE_TO_INCLUDE && igmp_version(ifindex) < 3))
+        igmp_schedule(ifindex, group, record_type, igmp_random_delay(IGMP_UNSOLICITED_INTERVAL_MS), IGMP_ROBUSTNESS - 1);
+}
+
+/**
+ * @brief 网卡加入组播组并发送主动报告
+ *
+ * @param ifindex 网卡编号
+ * @param group 组播地址
+ * @return int 成功为0，失败为-1
+ */
+int igmp_join(int ifindex, const uint8_t *group) {
+    if (net_if_group_add(ifindex, group) < 0)
+        return -1;
+    igmp_state_change(ifindex, group, IGMP_CHANGE_TO_EXCLUDE);
+    return 0;
+}
+
+/**
+ * @brief 网卡退出组播组并通告路由器
+ *
+ * @param ifindex 网卡编号
+ * @param group 组播地址
+ * @return int 成功为0，未加入该组时为-1
+ */
+int igmp_leave(int ifindex, const uint8_t *group) {
+    if (net_if_group_delete(ifindex, group) < 0)
+        return -1;
+    igmp_state_change(ifindex, group, IGMP_CHANGE_TO_INCLUDE);
+    return 0;
+}
+
+/**
+ * @brief 解析查询报文的最大响应时间
+ *
+ * @return uint64_t 最大响应时间（毫秒）
+ */
+static uint64_t igmp_max_resp_ms(igmp_hdr_t *hdr, size_t len) {
+    uint32_t code = hdr->max_resp;
+    if (len >= IGMP_V3_QUERY_MIN_LEN && code >= 128)
+        code = ((code & 0x0f) | 0x10) << (((code >> 4) & 0x07) + 3);  // v3 浮点格式
+    else if (len < IGMP_V3_QUERY_MIN_LEN && code == 0)
+        code = IGMP_DEFAULT_MAX_RESP;
+    return (uint64_t)code * 100;
+}
+
+/**
+ * @brief 处理一个收到的查询报文
+ *
+ */
+static void igmp_query(int ifindex, igmp_hdr_t *hdr, size_t len) {
+    igmp_if_t *igmp_if = &igmp_ifs[ifindex];
+    net_if_t *nif = &net_ifs[ifindex];
+    if (len < IGMP_V3_QUERY_MIN_LEN) {
+        // 旧版本查询者存在期间以旧版本应答
+        if (hdr->max_resp == 0)
+            igmp_if->v1_until = clock_ms() + IGMP_OLDER_QUERIER_TIMEOUT_MS;
+        else
+            igmp_if->v2_until = clock_ms() + IGMP_OLDER_QUERIER_TIMEOUT_MS;
+    }
+    uint64_t delay = igmp_random_delay(igmp_max_resp_ms(hdr, len));
+    static const uint8_t any[NET_IP_LEN] = {0};
+    if (memcmp(hdr->group, any, NET_IP_LEN)) {
+        // 特定组查询：只应答已加入的组
+        for (int i = 0; i < nif->group_num; i++)
+            if (!memcmp(nif->groups[i], hdr->group, NET_IP_LEN))
+                igmp_schedule(ifindex, hdr->group, IGMP_MODE_IS_EXCLUDE, delay, 1);
+        return;
+    }
+    if (igmp_version(ifindex) == 3) {
+        // 通用查询：v3 以一个报告合并应答所有组
+        uint64_t due = clock_ms() + delay;
+        if (igmp_if->general_due == 0 || due < igmp_if->general_due)
+            igmp_if->general_due = due;
+        return;
+    }
+    for (int i = 0; i < nif->group_num; i++)
+        if (memcmp(nif->groups[i], igmp_all_hosts, NET_IP_LEN))
+            igmp_schedule(ifindex, nif->groups[i], IGMP_MODE_IS_EXCLUDE, delay, 1);
+}
+
+/**
+ * @brief 处理一个收到的IGMP报文
+ *
+ * @param buf 要处理的数据包
+ * @param src_ip 源ip地址
+ */
+void igmp_in(buf_t *buf, uint8_t *src_ip) {
+    if (buf->len < IGMP_MIN_LEN)
+        return;
+    if (checksum16((uint16_t *)buf->data, buf->len) != 0)
+        return;
+    igmp_hdr_t *hdr = (igmp_hdr_t *)buf->data;
+    switch (hdr->type) {
+        case IGMP_TYPE_QUERY:
+            igmp_query(net_if_rx, hdr, buf->len);
+            break;
+        case IGMP_TYPE_V1_REPORT:
+        case IGMP_TYPE_V2_REPORT: {
+            // v1/v2 中网段上已有主机报告了该组，取消本机尚未发出的查询应答
+            if (igmp_version(net_if_rx) == 3)
+                break;
+            igmp_key_t key = {net_if_rx};
+            memcpy(key.group, hdr->group, NET_IP_LEN);
+            igmp_timer_t *timer = map_get(&igmp_timer_table, &key);
+            if (timer && timer->record_type == IGMP_MODE_IS_EXCLUDE)
+                map_delete(&igmp_timer_table, &key);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief 发送一个到期的待发报告
+ *
+ */
+static void igmp_timer_fn(void *key, void *value, time_t *timestamp) {
+    igmp_key_t *igmp_key = key;
+    igmp_timer_t *timer = value;
+    uint64_t now = clock_ms();
+    if (now < timer->due)
+        return;
+    igmp_send_group(igmp_key->ifindex, igmp_key->group, timer->record_type);
+    if (--timer->count == 0)
+        map_delete(&igmp_timer_table, key);
+    else
+        timer->due = now + igmp_random_delay(IGMP_UNSOLICITED_INTERVAL_MS);
+}
+
+/**
+ * @brief 初始化igmp协议，为启动时已加入的组发送主动报告
+ *
+ */
+void igmp_init() {
+    map_init(&igmp_timer_table, sizeof(igmp_key_t), sizeof(igmp_timer_t), 0, 0, NULL, NULL);
+    memset(igmp_ifs, 0, sizeof(igmp_ifs));
+    net_add_protocol(NET_PROTOCOL_IGMP, igmp_in);
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].group_num; j++)
+            igmp_state_change(i, net_ifs[i].groups[j], IGMP_CHANGE_TO_EXCLUDE);
+}
+
+/**
+ * @brief 一次igmp轮询，发送到期的查询应答与主动报告的重传
+ *
+ */
+void igmp_poll() {
+    static uint64_t last_poll;
+    uint64_t now = clock_ms();
+    if (now - last_poll < IGMP_POLL_INTERVAL_MS)
+        return;
+    last_poll = now;
+    for (int i = 0; i < net_if_num; i++) {
+        if (igmp_ifs[i].general_due && now >= igmp_ifs[i].general_due) {
+            igmp_ifs[i].general_due = 0;
+            igmp_send_v3(i, NULL, IGMP_MODE_IS_EXCLUDE);
+        }
+    }
+    map_foreach(&igmp_timer_table, igmp_timer_fn);
+}
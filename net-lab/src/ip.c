@@ -5,7 +5,159 @@
 #include "icmp.h"
 #include "net.h"
 
+/**
+ * @brief 分片重组表
+ *
+ */
+static map_t ip_reasm_table;  // [src_ip, dst_ip, id, protocol] -> ip_reasm
+/**
+ * @brief 所有重组数据报占用的缓存块总字节数
+ *
+ */
+static size_t ip_reasm_mem;
+/**
+ * @brief 重组缓存池，重复或重叠的分片落在已分配的块内，不再占用缓存
+ *
+ */
+static uint8_t ip_reasm_pool[IP_REASM_POOL_NUM][IP_REASM_CHUNK_LEN];
+static uint16_t ip_reasm_free[IP_REASM_POOL_NUM];  // 空闲块编号的栈
+static size_t ip_reasm_free_num;
 
+/**
+ * @brief 当前正在处理的数据报的目的地址，即收到该数据报的本机地址或广播、组播地址，
+ * 上层据此校验伪首部并选择应答的源地址
+ *
+ */
+uint8_t ip_in_dst[NET_IP_LEN];
+
+/**
+ * @brief 释放一个重组数据报
+ *
+ * @param key 重组数据报的键
+ * @param reasm 重组数据报
+ */
+static void ip_reasm_drop(ip_reasm_key_t *key, ip_reasm_t *reasm) {
+    for (int i = 0; i < IP_REASM_CHUNK_NUM; i++)
+        if (reasm->chunks[i])
+            ip_reasm_free[ip_reasm_free_num++] = reasm->chunks[i] - 1;
+    ip_reasm_mem -= reasm->mem;
+    map_delete(&ip_reasm_table, key);
+}
+
+/**
+ * @brief 将一个分片并入重组数据报，按 RFC 815 更新空洞描述符
+ *
+ * @param buf 收到的分片，去除填充后以IP头部开始；重组完成时被替换为完整的数据报
+ * @return int 重组完成为1，否则为0
+ */
+static int ip_reassemble(buf_t *buf) {
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+    uint16_t hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    uint16_t flags_fragment = swap16(ip_hdr->flags_fragment16);
+    uint32_t first = (flags_fragment & IP_OFFSET_MASK) * IP_HDR_OFFSET_PER_BYTE;
+    uint32_t len = buf->len - hdr_len;
+    uint32_t end = first + len;
+    int more = (flags_fragment & IP_MORE_FRAGMENT) != 0;
+    // 除最后一个分片外，分片载荷必须为8字节的整数倍；重组后的数据报不能超过单个数据报的上限
+    if ((more && len % IP_HDR_OFFSET_PER_BYTE) || len == 0 || end > IP_REASM_MAX_LEN)
+        return 0;
+
+    ip_reasm_key_t key;
+    memset(&key, 0, sizeof(key));
+    memcpy(key.src_ip, ip_hdr->src_ip, NET_IP_LEN);
+    memcpy(key.dst_ip, ip_hdr->dst_ip, NET_IP_LEN);
+    key.id = ip_hdr->id16;
+    key.protocol = ip_hdr->protocol;
+    ip_reasm_t *reasm = map_get(&ip_reasm_table, &key);
+    if (!reasm) {
+        // 以一个覆盖全部载荷的空洞开始，尚未分配任何缓存块
+        ip_reasm_t new_reasm;
+        memset(&new_reasm, 0, sizeof(new_reasm));
+        new_reasm.deadline = clock_ms() + net_config.ip_reasm_timeout_ms;
+        new_reasm.hole_num = 1;
+        new_reasm.holes[0].first = 0;
+        new_reasm.holes[0].end = IP_REASM_MAX_LEN;
+        if (map_set(&ip_reasm_table, &key, &new_reasm) != 0)
+            return 0;
+        reasm = map_get(&ip_reasm_table, &key);
+    }
+    // 只有分片首次落入的缓存块计入全局上限，超出时丢弃该分片，对端重传或超时后释放
+    size_t chunk_num = 0;
+    for (uint32_t i = first / IP_REASM_CHUNK_LEN; i <= (end - 1) / IP_REASM_CHUNK_LEN; i++)
+        chunk_num += !reasm->chunks[i];
+    if (ip_reasm_mem + chunk_num * IP_REASM_CHUNK_LEN > net_config.ip_reasm_mem_limit ||
+        chunk_num > ip_reasm_free_num) {
+        if (!reasm->mem)
+            ip_reasm_drop(&key, reasm);
+        return 0;
+    }
+
+    ip_hole_t holes[IP_REASM_MAX_HOLES];
+    uint8_t hole_num = 0;
+    for (uint8_t i = 0; i < reasm->hole_num; i++) {
+        ip_hole_t hole = reasm->holes[i];
+        // 最后一个分片确定了总长度，其后的空洞不复存在
+        if (!more && hole.first >= end)
+            continue;
+        if (end <= hole.first || first >= hole.end) {
+            holes[hole_num++] = hole;
+            continue;
+        }
+        // 分片与空洞重叠：空洞被分片切开，两侧剩余的部分成为新的空洞
+        if (first > hole.first) {
+            if (hole_num == IP_REASM_MAX_HOLES)
+                goto overflow;
+            holes[hole_num++] = (ip_hole_t){hole.first, first};
+        }
+        if (end < hole.end && more) {
+            if (hole_num == IP_REASM_MAX_HOLES)
+                goto overflow;
+            holes[hole_num++] = (ip_hole_t){end, hole.end};
+        }
+    }
+    memcpy(reasm->holes, holes, hole_num * sizeof(ip_hole_t));
+    reasm->hole_num = hole_num;
+    for (uint32_t pos = first; pos < end;) {
+        uint16_t *chunk = &reasm->chunks[pos / IP_REASM_CHUNK_LEN];
+        if (!*chunk)
+            *chunk = ip_reasm_free[--ip_reasm_free_num] + 1;
+        uint32_t n = IP_REASM_CHUNK_LEN - pos % IP_REASM_CHUNK_LEN;
+        if (n > end - pos)
+            n = end - pos;
+        memcpy(ip_reasm_pool[*chunk - 1] + pos % IP_REASM_CHUNK_LEN, buf->data + hdr_len + pos - first, n);
+        pos += n;
+    }
+    reasm->mem += chunk_num * IP_REASM_CHUNK_LEN;
+    ip_reasm_mem += chunk_num * IP_REASM_CHUNK_LEN;
+    if (!more)
+        reasm->total_len = end;
+    if (first == 0) {
+        reasm->hdr_len = hdr_len;
+        memcpy(reasm->hdr, buf->data, hdr_len);
+    }
+    if (reasm->hole_num)
+        return 0;
+
+    // 重组完成：以首个分片的首部拼接完整的数据报，清除分片字段并重新计算校验和
+    buf_init(buf, reasm->hdr_len + reasm->total_len);
+    memcpy(buf->data, reasm->hdr, reasm->hdr_len);
+    for (uint32_t pos = 0; pos < reasm->total_len; pos += IP_REASM_CHUNK_LEN) {
+        uint32_t n = reasm->total_len - pos < IP_REASM_CHUNK_LEN ? reasm->total_len - pos : IP_REASM_CHUNK_LEN;
+        memcpy(buf->data + reasm->hdr_len + pos, ip_reasm_pool[reasm->chunks[pos / IP_REASM_CHUNK_LEN] - 1], n);
+    }
+    ip_hdr = (ip_hdr_t *)buf->data;
+    ip_hdr->total_len16 = swap16(buf->len);
+    ip_hdr->flags_fragment16 = 0;
+    ip_hdr->hdr_checksum16 = 0;
+    ip_hdr->hdr_checksum16 = checksum16((uint16_t *)ip_hdr, reasm->hdr_len);
+    ip_reasm_drop(&key, reasm);
+    return 1;
+
+overflow:
+    // 空洞过多，多为恶意构造的分片，放弃整个数据报
+    ip_reasm_drop(&key, reasm);
+    return 0;
+}
 
 /**
  * @brief 处理一个收到的数据包
@@ -54,10 +206,12 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
     ip_hdr->hdr_checksum16 = orig_checksum;
 
     // Step4: 对比目的IP地址 
-    // 检查目的IP是否为本机IP，非本机则丢弃
-    if (memcmp(ip_hdr->dst_ip, net_if_ip, NET_IP_LEN) != 0) {
+    // 接收发往任一网卡地址、广播地址，以及发往收包网卡已加入的组播组的数据报，其余丢弃
+    if (net_if_lookup(ip_hdr->dst_ip) < 0 && !net_if_is_broadcast(ip_hdr->dst_ip) &&
+        !(IP_IS_MULTICAST(ip_hdr->dst_ip) && net_if_group_member(net_if_rx, ip_hdr->dst_ip))) {
         return;
     }
+    memcpy(ip_in_dst, ip_hdr->dst_ip, NET_IP_LEN);
 
     //  Step5: 去除填充字段 
     // 若数据包实际长度 > IP总长度字段，说明存在填充，移除多余部分
@@ -65,11 +219,20 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
         buf_remove_padding(buf, buf->len - ip_total_len);
     }
 
-    //  Step6: 去掉IP报头 
+    // Step6: 分片重组
+    // 收到分片时并入重组表，数据报尚未完整则返回；完整后以重组的数据报继续处理
+    if (swap16(ip_hdr->flags_fragment16) & (IP_MORE_FRAGMENT | IP_OFFSET_MASK)) {
+        if (!ip_reassemble(buf))
+            return;
+        ip_hdr = (ip_hdr_t *)buf->data;
+        actual_hdr_len = ip_hdr->hdr_len * IP_HDR_LEN_PER_BYTE;
+    }
+
+    //  Step7: 去掉IP报头 
     // 移除IP头部，缓冲区剩余数据为上层协议载荷
     buf_remove_header(buf, actual_hdr_len);
 
-    // Step7: 向上层传递数据包 
+    // Step8: 向上层传递数据包 
     // 调用net_in向上层传递数据包，返回值表示是否识别该协议类型
     int ret = net_in(buf, ip_hdr->protocol,ip_hdr->src_ip);
 
@@ -82,16 +245,294 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
     }
 }
 /**
- * @brief 处理一个要发送的ip分片
+ * @brief 路由表，按前缀长度升序、度量降序排列
+ *
+ */
+static ip_route_t ip_route_table[IP_ROUTE_MAX_NUM];
+static size_t ip_route_num;
+/**
+ * @brief 由路由表生成的多比特 trie，每层按地址的一个字节分支，查找最多访问 NET_IP_LEN 个节点
+ *
+ */
+static ip_route_node_t ip_route_nodes[IP_ROUTE_NODE_MAX_NUM];
+static size_t ip_route_node_num;
+/**
+ * @brief 路由表的版本号，每次路由表变化时递增，使目的地址缓存失效
+ *
+ */
+static uint32_t ip_route_gen = 1;
+/**
+ * @brief 路由表是否已按网卡配置初始化
+ *
+ */
+static int ip_route_ready;
+/**
+ * @brief 目的地址缓存，按目的地址散列的直接映射表，冲突时覆盖
+ *
+ */
+static ip_dst_t ip_dst_cache[IP_DST_CACHE_SIZE];
+
+/**
+ * @brief 比较两条路由的插入顺序：前缀短的在前，前缀相同时度量大的在前
+ *
+ */
+static int ip_route_compare(const void *a, const void *b) {
+    const ip_route_t *ra = a, *rb = b;
+    if (ra->prefix_len != rb->prefix_len)
+        return ra->prefix_len - rb->prefix_len;
+    return ra->metric < rb->metric ? 1 : ra->metric > rb->metric ? -1 : 0;
+}
+
+/**
+ * @brief 将一条路由插入 trie，前缀在所在层展开为连续的分支
+ *
+ * 按 ip_route_compare 的顺序插入，后插入的更长前缀或更小度量覆盖先插入的展开项
+ *
+ * @param idx 路由在路由表中的编号
+ */
+static void ip_route_insert(size_t idx) {
+    ip_route_t *route = &ip_route_table[idx];
+    ip_route_node_t *node = &ip_route_nodes[0];
+    for (size_t level = 0;; level++) {
+        size_t bits = (level + 1) * IP_ROUTE_STRIDE;
+        size_t b = route->dst[level];
+        if (route->prefix_len <= bits) {
+            size_t span = 1 << (bits - route->prefix_len);
+            b &= ~(span - 1);
+            for (size_t i = b; i < b + span; i++)
+                node->route[i] = idx + 1;
+            return;
+        }
+        if (!node->child[b]) {
+            memset(&ip_route_nodes[ip_route_node_num], 0, sizeof(ip_route_node_t));
+            node->child[b] = ip_route_node_num++;
+        }
+        node = &ip_route_nodes[node->child[b]];
+    }
+}
+
+/**
+ * @brief 路由表变化后重新排序并生成 trie
+ *
+ */
+static void ip_route_rebuild() {
+    qsort(ip_route_table, ip_route_num, sizeof(ip_route_t), ip_route_compare);
+    memset(&ip_route_nodes[0], 0, sizeof(ip_route_node_t));
+    ip_route_node_num = 1;
+    for (size_t i = 0; i < ip_route_num; i++)
+        ip_route_insert(i);
+    ip_route_gen++;
+}
+
+/**
+ * @brief 由子网掩码计算前缀长度
+ *
+ * @param netmask 子网掩码
+ * @return int 前缀长度，掩码不连续时为-1
+ */
+static int ip_route_prefix_len(uint8_t *netmask) {
+    uint32_t mask = (uint32_t)netmask[0] << 24 | netmask[1] << 16 | netmask[2] << 8 | netmask[3];
+    int len = 0;
+    while (len < 32 && (mask & (1u << (31 - len))))
+        len++;
+    if (len < 32 && (mask << len))
+        return -1;
+    return len;
+}
+
+/**
+ * @brief 添加一条路由，目的网络与网关都相同的路由只更新度量
+ *
+ * @param dst 目的网络
+ * @param netmask 子网掩码，必须连续
+ * @param gateway 网关，全0表示目的网络直连
+ * @param metric 度量
+ * @return int 成功为0，失败为-1
+ */
+int ip_route_add(uint8_t *dst, uint8_t *netmask, uint8_t *gateway, uint32_t metric) {
+    int prefix_len = ip_route_prefix_len(netmask);
+    if (prefix_len < 0)
+        return -1;
+    ip_route_t route = {.prefix_len = prefix_len, .metric = metric};
+    for (size_t i = 0; i < NET_IP_LEN; i++)
+        route.dst[i] = dst[i] & netmask[i];
+    memcpy(route.netmask, netmask, NET_IP_LEN);
+    memcpy(route.gateway, gateway, NET_IP_LEN);
+
+    size_t i;
+    for (i = 0; i < ip_route_num; i++)
+        if (ip_route_table[i].prefix_len == prefix_len && !memcmp(ip_route_table[i].dst, route.dst, NET_IP_LEN) &&
+            !memcmp(ip_route_table[i].gateway, gateway, NET_IP_LEN))
+            break;
+    if (i == ip_route_num) {
+        if (ip_route_num == IP_ROUTE_MAX_NUM)
+            return -1;
+        ip_route_num++;
+    }
+    ip_route_table[i] = route;
+    ip_route_rebuild();
+    return 0;
+}
+
+/**
+ * @brief 删除到目的网络的所有路由
+ *
+ * @param dst 目的网络
+ * @param netmask 子网掩码
+ * @return int 删除了路由为0，没有匹配的路由为-1
+ */
+int ip_route_delete(uint8_t *dst, uint8_t *netmask) {
+    int prefix_len = ip_route_prefix_len(netmask);
+    uint8_t masked[NET_IP_LEN];
+    for (size_t i = 0; i < NET_IP_LEN; i++)
+        masked[i] = dst[i] & netmask[i];
+    size_t num = 0;
+    for (size_t i = 0; i < ip_route_num; i++)
+        if (ip_route_table[i].prefix_len != prefix_len || memcmp(ip_route_table[i].dst, masked, NET_IP_LEN))
+            ip_route_table[num++] = ip_route_table[i];
+    if (num == ip_route_num)
+        return -1;
+    ip_route_num = num;
+    ip_route_rebuild();
+    return 0;
+}
+
+/**
+ * @brief 以网卡配置初始化路由表：每个网卡地址的直连网段与默认网关
+ *
+ */
+static void ip_route_init() {
+    uint8_t any[NET_IP_LEN] = {0};
+    net_if_init();
+    ip_route_num = 0;
+    ip_route_ready = 1;
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr_num; j++)
+            ip_route_add(net_ifs[i].addrs[j].ip, net_ifs[i].addrs[j].netmask, any, 0);
+    ip_route_add(any, any, net_config.gateway, 0);
+}
+
+/**
+ * @brief 最长前缀匹配查找到目的地址的路由
+ *
+ * @param ip 目标ip地址
+ * @return const ip_route_t* 匹配的路由，路由表下次变化前有效；没有可用路由为NULL
+ */
+const ip_route_t *ip_route_lookup(uint8_t *ip) {
+    // 未经 ip_init() 直接发送时（如单独测试ip层）按网卡配置生成路由表
+    if (!ip_route_ready)
+        ip_route_init();
+    ip_route_node_t *node = &ip_route_nodes[0];
+    uint16_t best = 0;
+    for (size_t level = 0; level < NET_IP_LEN; level++) {
+        uint8_t b = ip[level];
+        if (node->route[b])
+            best = node->route[b];
+        if (!node->child[b])
+            break;
+        node = &ip_route_nodes[node->child[b]];
+    }
+    return best ? &ip_route_table[best - 1] : NULL;
+}
+
+/**
+ * @brief 路由选出的下一跳，直连路由的下一跳即目的地址
+ *
+ */
+static inline uint8_t *ip_route_next_hop(const ip_route_t *route, uint8_t *ip) {
+    static const uint8_t on_link[NET_IP_LEN] = {0};
+    return memcmp(route->gateway, on_link, NET_IP_LEN) ? (uint8_t *)route->gateway : ip;
+}
+
+/**
+ * @brief 为发往目的地址的数据报选择源地址：出口网卡上与下一跳同网段的地址
+ *
+ * @param ip 目标ip地址
+ * @param src 出口参数，选出的源地址
+ */
+void ip_src_select(uint8_t *ip, uint8_t *src) {
+    const ip_route_t *route = ip_route_lookup(ip);
+    const uint8_t *addr = net_if_ip;
+    if (route)
+        net_if_select(ip_route_next_hop(route, ip), &addr);
+    memcpy(src, addr, NET_IP_LEN);
+}
+
+/**
+ * @brief 目的地址在缓存中的槽位
+ *
+ */
+static inline ip_dst_t *ip_dst_slot(uint8_t *ip) {
+    return &ip_dst_cache[(ip[0] ^ ip[1] ^ ip[2] ^ ip[3]) & (IP_DST_CACHE_SIZE - 1)];
+}
+
+/**
+ * @brief 查找目的地址缓存，路由表或arp表变化后、或缓存项过期后视为未命中
+ *
+ * @param ip 目标ip地址
+ * @return ip_dst_t* 可用的缓存项，未命中为NULL
+ */
+static ip_dst_t *ip_dst_lookup(uint8_t *ip) {
+    ip_dst_t *dst = ip_dst_slot(ip);
+    if (memcmp(dst->ip, ip, NET_IP_LEN) || dst->route_gen != ip_route_gen || dst->arp_gen != arp_gen || time(NULL) >= dst->expire)
+        return NULL;
+    return dst;
+}
+
+/**
+ * @brief 下一跳已在arp表中时为目的地址填写缓存项
+ *
+ * @param ip 目标ip地址
+ * @param next_hop 路由选出的下一跳
+ */
+static void ip_dst_update(uint8_t *ip, uint8_t *next_hop) {
+    uint8_t *mac = arp_lookup(next_hop);
+    if (!mac)
+        return;
+    ip_dst_t *dst = ip_dst_slot(ip);
+    dst->ifindex = net_if_select(next_hop, NULL);
+    memcpy(dst->ip, ip, NET_IP_LEN);
+    dst->route_gen = ip_route_gen;
+    dst->arp_gen = arp_gen;
+    dst->expire = time(NULL) + net_config.ip_dst_cache_timeout_sec;
+    memcpy(dst->eth_hdr.dst, mac, NET_MAC_LEN);
+    memcpy(dst->eth_hdr.src, net_ifs[dst->ifindex].mac, NET_MAC_LEN);
+    dst->eth_hdr.protocol16 = swap16(NET_PROTOCOL_IP);
+}
+
+/**
+ * @brief 发往组播地址与广播地址的数据报不经过路由与arp，直接以对应的mac地址从源地址所在网卡发出
+ *
+ * @param buf 要发送的数据报，以IP头部开始
+ * @param src 源ip地址
+ * @param ip 目标ip地址
+ * @return int 已发送为1，目的地址是单播地址时为0
+ */
+static int ip_link_out(buf_t *buf, uint8_t *src, uint8_t *ip) {
+    static const uint8_t broadcast_mac[NET_MAC_LEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    uint8_t mac[NET_MAC_LEN];
+    if (IP_IS_MULTICAST(ip))
+        net_if_group_mac(ip, mac);
+    else if (net_if_is_broadcast(ip))
+        memcpy(mac, broadcast_mac, NET_MAC_LEN);
+    else
+        return 0;
+    int ifindex = net_if_lookup(src);
+    ethernet_out_if(ifindex < 0 ? 0 : ifindex, buf, mac, NET_PROTOCOL_IP);
+    return 1;
+}
+
+/**
+ * @brief 填写IP头部并发送
  *
  * @param buf 要发送的分片
+ * @param src 源ip地址
  * @param ip 目标ip地址
  * @param protocol 上层协议
  * @param id 数据包id
- * @param offset 分片offset，必须被8整除
- * @param mf 分片mf标志，是否有下一个分片
+ * @param flags_fragment 标志与分段字段（主机字节序）
  */
-void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
+static void ip_hdr_out(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol, int id, uint16_t flags_fragment) {
     // Step1: 增加IP头部缓存空间 基础IP头部长度 = 5 * IP_HDR_LEN_PER_BYTE = 5*4=20字节
     buf_add_header(buf, IP_HDR_LEN * IP_HDR_LEN_PER_BYTE);
     
@@ -108,19 +549,14 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
     ip_hdr->total_len16 = swap16(buf->len);
     // 4. 标识符：分片唯一标识（转网络字节序）
     ip_hdr->id16 = swap16(id);
-    // 5. 标志与分段：MF位 + 分片偏移（偏移转换为8字节单位，转网络字节序）
-    uint16_t flags_fragment = 0;
-    if (mf) {
-        flags_fragment |= IP_MORE_FRAGMENT; // 设置MF位（有更多分片）
-    }
-    flags_fragment |= (offset / IP_HDR_OFFSET_PER_BYTE); // 偏移转换为8字节单位
+    // 5. 标志与分段：DF位 + MF位 + 分片偏移（转网络字节序）
     ip_hdr->flags_fragment16 = swap16(flags_fragment);
-    // 6. 存活时间：默认64
-    ip_hdr->ttl = IP_DEFAULT_TTL;
+    // 6. 存活时间：组播数据报默认只在本网段内传播
+    ip_hdr->ttl = IP_IS_MULTICAST(ip) ? IP_MULTICAST_TTL : net_config.ttl;
     // 7. 上层协议类型（如NET_PROTOCOL_ICMP/NET_PROTOCOL_TCP等）
     ip_hdr->protocol = protocol;
-    // 8. 源IP地址：本机IP
-    memcpy(ip_hdr->src_ip, net_if_ip, NET_IP_LEN);
+    // 8. 源IP地址：选定的本机地址
+    memcpy(ip_hdr->src_ip, src, NET_IP_LEN);
     // 9. 目标IP地址：传入的目的IP
     memcpy(ip_hdr->dst_ip, ip, NET_IP_LEN);
     // 10. 首部校验和：先置0，后续计算
@@ -129,69 +565,273 @@ void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, u
     // Step3: 计算并填写校验和 计算范围：仅IP头部（20字节），结果填回校验和字段
     ip_hdr->hdr_checksum16 = checksum16((uint16_t *)ip_hdr, IP_HDR_LEN * IP_HDR_LEN_PER_BYTE);
 
-    //Step4: 发送数据 交给ARP层处理IP→MAC映射，最终通过以太网发送
-    arp_out(buf, ip);
+    //Step4: 发送数据 组播与广播数据报直接发出；命中目的地址缓存时直接以缓存的以太网包头发送，
+    // 否则按路由选择下一跳，交给ARP层处理下一跳IP→MAC映射，最终通过以太网发送
+    if (ip_link_out(buf, src, ip))
+        return;
+    ip_dst_t *dst = ip_dst_lookup(ip);
+    if (dst) {
+        ethernet_out_prebuilt(dst->ifindex, buf, &dst->eth_hdr);
+        return;
+    }
+    const ip_route_t *route = ip_route_lookup(ip);
+    if (!route) {
+        return; // 没有到目的地址的路由，丢弃
+    }
+    uint8_t *next_hop = ip_route_next_hop(route, ip);
+    ip_dst_update(ip, next_hop);
+    arp_out(buf, next_hop);
+}
+
+/**
+ * @brief 处理一个要发送的ip分片
+ *
+ * @param buf 要发送的分片
+ * @param src 源ip地址
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ * @param id 数据包id
+ * @param offset 分片offset，必须被8整除
+ * @param mf 分片mf标志，是否有下一个分片
+ */
+void ip_fragment_out(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
+    uint16_t flags_fragment = offset / IP_HDR_OFFSET_PER_BYTE; // 偏移转换为8字节单位
+    if (mf) {
+        flags_fragment |= IP_MORE_FRAGMENT; // 设置MF位（有更多分片）
+    }
+    ip_hdr_out(buf, src, ip, protocol, id, flags_fragment);
 }
 // 全局IP标识
 static uint16_t ip_id = 0;
+// 分片发送时下层协议头占用的空间（IP头部 + 以太网头部）
+#define IP_FRAG_HDR_ROOM (IP_HDR_BYTES + sizeof(ether_hdr_t))
+
+/**
+ * @brief 路径MTU缓存
+ *
+ */
+static map_t ip_pmtu_table;  // ip -> ip_pmtu
+/**
+ * @brief 路径MTU缓存的版本号，每次有条目变化时递增，上层据此判断缓存的路径MTU是否需要刷新
+ *
+ */
+uint32_t ip_pmtu_gen = 1;
+
+/**
+ * @brief 查询到目的地址的路径MTU
+ *
+ * @param ip 目标ip地址
+ * @param locked 出口参数，可为NULL，路径MTU是否已钳位到下限、不应再设置DF位
+ * @return uint16_t 路径MTU，未缓存时为链路MTU
+ */
+static uint16_t ip_pmtu_lookup(uint8_t *ip, int *locked) {
+    ip_pmtu_t *pmtu = map_size(&ip_pmtu_table) ? map_get(&ip_pmtu_table, ip) : NULL;
+    if (locked)
+        *locked = pmtu && pmtu->locked;
+    return pmtu ? pmtu->mtu : net_config.mtu;
+}
+
+/**
+ * @brief 查询到目的地址的路径MTU
+ *
+ * @param ip 目标ip地址
+ * @return uint16_t 路径MTU，未缓存时为链路MTU
+ */
+uint16_t ip_pmtu(uint8_t *ip) {
+    return ip_pmtu_lookup(ip, NULL);
+}
+
+/**
+ * @brief 根据ICMP需要分片报文更新到目的地址的路径MTU，只会降低，升高依靠缓存过期
+ *
+ * @param ip 目标ip地址
+ * @param mtu 下一跳通告的MTU
+ */
+void ip_pmtu_update(uint8_t *ip, uint16_t mtu) {
+    ip_pmtu_t pmtu = {mtu, 0};
+    if (mtu < IP_PMTU_MIN) {
+        pmtu.mtu = IP_PMTU_MIN;
+        pmtu.locked = 1;
+    }
+    int locked;
+    uint16_t cur = ip_pmtu_lookup(ip, &locked);
+    if (pmtu.mtu > cur || (pmtu.mtu == cur && (locked || !pmtu.locked)))
+        return;
+    if (map_set(&ip_pmtu_table, ip, &pmtu) == 0)
+        ip_pmtu_gen++;
+}
+
+/**
+ * @brief 以指定的源地址发送一个ip数据包，用于以收到请求的本机地址应答
+ *
+ * @param buf 要处理的包
+ * @param src 源ip地址，必须是本机地址
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void ip_out_src(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    // Step1: 检查数据报包长，无需分片时直接发送完整包（偏移=0，MF=0）
+    // 按路径MTU分片，避免途中的路由器再次分片
+    uint16_t cur_id = ip_id++;
+    size_t max_payload = (ip_pmtu(ip) - IP_HDR_BYTES) / IP_HDR_OFFSET_PER_BYTE * IP_HDR_OFFSET_PER_BYTE;
+    if (buf->len <= max_payload) {
+        ip_fragment_out(buf, src, ip, protocol, cur_id, 0, 0);
+        return;
+    }
+
+    // Step2: 分片处理
+    // 每个分片都是原数据包载荷的一个视图，下层协议头直接写在视图前方，
+    // 覆盖的是前一个已发送分片的尾部，发送后恢复这部分字节，载荷本身不做拷贝
+    uint8_t *payload = buf->data;
+    size_t payload_len = buf->len;
+    uint8_t saved[IP_FRAG_HDR_ROOM];
+    for (size_t sent_len = 0; sent_len < payload_len; sent_len += max_payload) {
+        size_t frag_len = payload_len - sent_len;
+        int mf = frag_len > max_payload;
+        if (mf)
+            frag_len = max_payload;
+
+        buf->data = payload + sent_len;
+        buf->len = frag_len;
+        memcpy(saved, buf->data - IP_FRAG_HDR_ROOM, IP_FRAG_HDR_ROOM);
+        ip_fragment_out(buf, src, ip, protocol, cur_id, sent_len, mf);
+        memcpy(payload + sent_len - IP_FRAG_HDR_ROOM, saved, IP_FRAG_HDR_ROOM);
+    }
+    buf->data = payload;
+    buf->len = payload_len;
+}
+
 /**
- * @brief 处理一个要发送的ip数据包
+ * @brief 处理一个要发送的ip数据包，源地址按路由选择
  *
  * @param buf 要处理的包
  * @param ip 目标ip地址
  * @param protocol 上层协议
  */
 void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
-    // Step1: 检查数据报包长
-    size_t payload_len = buf->len; // 上层数据长度（IP载荷）
-    int need_fragment = (payload_len > IP_MAX_PAYLOAD); // 是否需要分片
-
-    // Step2: 分片处理 
-    if (need_fragment) {
-        // 生成唯一IP标识（所有分片共用）
-        uint16_t cur_id = ip_id++;
-        // 已发送的载荷长度
-        size_t sent_len = 0;
-        // 分片偏移（字节单位）
-        uint16_t fragment_offset = 0;
-
-        // 发送除最后一个外的所有分片（每个分片载荷=IP_MAX_PAYLOAD）
-        while (sent_len + IP_MAX_PAYLOAD < payload_len) {
-            // Step2.1 初始化分片缓冲区
-            buf_t frag_buf;
-            buf_init(&frag_buf, IP_MAX_PAYLOAD);
-            // 拷贝当前分片数据
-            memcpy(frag_buf.data, buf->data + sent_len, IP_MAX_PAYLOAD);
-            frag_buf.len = IP_MAX_PAYLOAD;
-
-            // Step2.2 发送分片（MF=1，有更多分片）
-            ip_fragment_out(&frag_buf, ip, protocol, cur_id, fragment_offset, 1);
-
-            // 更新已发送长度和分片偏移
-            sent_len += IP_MAX_PAYLOAD;
-            fragment_offset += IP_MAX_PAYLOAD;
-        }
+    uint8_t src[NET_IP_LEN];
+    ip_src_select(ip, src);
+    ip_out_src(buf, src, ip, protocol);
+}
 
-        // 发送最后一个分片
-        size_t last_frag_len = payload_len - sent_len;
-        if (last_frag_len > 0) {
-            // Step2.3 初始化最后一个分片缓冲区
-            buf_t last_frag_buf;
-            buf_init(&last_frag_buf, last_frag_len);
-            memcpy(last_frag_buf.data, buf->data + sent_len, last_frag_len);
-            last_frag_buf.len = last_frag_len;
-
-            // Step2.4 发送最后一个分片（MF=0，无更多分片）
-            ip_fragment_out(&last_frag_buf, ip, protocol, cur_id, fragment_offset, 0);
-        }
+/**
+ * @brief 发送一个带路由器告警选项（RFC 2113）的组播数据报，用于IGMP等需要途中路由器检查的报文
+ *
+ * 数据报不分片，TTL固定为1
+ *
+ * @param buf 要处理的包
+ * @param src 源ip地址
+ * @param ip 目标组播地址
+ * @param protocol 上层协议
+ */
+void ip_out_router_alert(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    static const uint8_t router_alert[IP_ROUTER_ALERT_LEN] = {0x94, 0x04, 0x00, 0x00};
+    buf_add_header(buf, IP_HDR_BYTES + IP_ROUTER_ALERT_LEN);
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+    memset(ip_hdr, 0, sizeof(ip_hdr_t));
+    ip_hdr->version = IP_VERSION_4;
+    ip_hdr->hdr_len = (IP_HDR_BYTES + IP_ROUTER_ALERT_LEN) / IP_HDR_LEN_PER_BYTE;
+    ip_hdr->tos = IP_DEFAULT_TOS;
+    ip_hdr->total_len16 = swap16(buf->len);
+    uint16_t id = ip_id++;
+    ip_hdr->id16 = swap16(id);
+    ip_hdr->ttl = IP_MULTICAST_TTL;
+    ip_hdr->protocol = protocol;
+    memcpy(ip_hdr->src_ip, src, NET_IP_LEN);
+    memcpy(ip_hdr->dst_ip, ip, NET_IP_LEN);
+    memcpy(buf->data + IP_HDR_BYTES, router_alert, IP_ROUTER_ALERT_LEN);
+    ip_hdr->hdr_checksum16 = checksum16((uint16_t *)ip_hdr, IP_HDR_BYTES + IP_ROUTER_ALERT_LEN);
+    ip_link_out(buf, src, ip);
+}
+
+/**
+ * @brief 以路径MTU发现方式发送一个ip数据包：设置DF位，由途中的路由器以ICMP报文通告更小的MTU
+ *
+ * 上层应按 ip_pmtu() 控制数据包长度；路径MTU在此之后降低或已钳位到下限时退回到普通的分片发送
+ *
+ * @param buf 要处理的包
+ * @param src 源ip地址
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void ip_out_pmtu(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    int locked;
+    uint16_t mtu = ip_pmtu_lookup(ip, &locked);
+    if (locked || buf->len > mtu - IP_HDR_BYTES) {
+        ip_out_src(buf, src, ip, protocol);
+        return;
     }
-    // Step3: 直接发送（无需分片）
-    else {
-        // 生成唯一IP标识
-        uint16_t cur_id = ip_id++;
-        // 直接调用ip_fragment_out发送完整包（偏移=0，MF=0）
-        ip_fragment_out(buf, ip, protocol, cur_id, 0, 0);
+    ip_hdr_out(buf, src, ip, protocol, ip_id++, IP_DONT_FRAGMENT);
+}
+
+/**
+ * @brief 判断首部模板是否仍然可用
+ *
+ */
+static inline int ip_tmpl_valid(ip_tmpl_t *tmpl) {
+    return tmpl->route_gen == ip_route_gen && tmpl->arp_gen == arp_gen && tmpl->pmtu_gen == ip_pmtu_gen && time(NULL) < tmpl->expire;
+}
+
+/**
+ * @brief 由目的地址缓存生成首部模板
+ *
+ * @param tmpl 要生成的模板
+ * @param src 源ip地址
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ * @return int 成功为0；下一跳尚未解析或路径MTU已钳位到下限时为-1，此时只能走普通发送路径
+ */
+static int ip_tmpl_build(ip_tmpl_t *tmpl, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    ip_dst_t *dst = ip_dst_lookup(ip);
+    int locked;
+    uint16_t mtu = ip_pmtu_lookup(ip, &locked);
+    if (!dst || locked)
+        return -1;
+    tmpl->eth_hdr = dst->eth_hdr;
+    tmpl->ifindex = dst->ifindex;
+    memset(&tmpl->ip_hdr, 0, sizeof(ip_hdr_t));
+    tmpl->ip_hdr.version = IP_VERSION_4;
+    tmpl->ip_hdr.hdr_len = IP_HDR_LEN;
+    tmpl->ip_hdr.tos = IP_DEFAULT_TOS;
+    tmpl->ip_hdr.flags_fragment16 = swap16(IP_DONT_FRAGMENT);
+    tmpl->ip_hdr.ttl = net_config.ttl;
+    tmpl->ip_hdr.protocol = protocol;
+    memcpy(tmpl->ip_hdr.src_ip, src, NET_IP_LEN);
+    memcpy(tmpl->ip_hdr.dst_ip, ip, NET_IP_LEN);
+    tmpl->ip_sum = checksum_partial(0, &tmpl->ip_hdr, sizeof(ip_hdr_t));
+    tmpl->mtu = mtu;
+    tmpl->route_gen = dst->route_gen;
+    tmpl->arp_gen = dst->arp_gen;
+    tmpl->pmtu_gen = ip_pmtu_gen;
+    tmpl->expire = dst->expire;
+    return 0;
+}
+
+/**
+ * @brief 以连接的首部模板发送一个ip数据包，与 ip_out_pmtu() 一样设置DF位
+ *
+ * 模板可用时只拷贝模板并填写总长度、标识符与校验和；模板失效时由目的地址缓存重新生成，
+ * 无法生成或数据包超过路径MTU时退回到 ip_out_pmtu()
+ *
+ * @param tmpl 连接的首部模板
+ * @param buf 要处理的包
+ * @param src 源ip地址，模板生成后不再改变
+ * @param ip 目标ip地址
+ * @param protocol 上层协议
+ */
+void ip_out_tmpl(ip_tmpl_t *tmpl, buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    if ((!ip_tmpl_valid(tmpl) && ip_tmpl_build(tmpl, src, ip, protocol) < 0) || buf->len > tmpl->mtu - IP_HDR_BYTES) {
+        ip_out_pmtu(buf, src, ip, protocol);
+        return;
     }
+    uint16_t id = ip_id++;
+    buf_add_header(buf, IP_HDR_BYTES);
+    memcpy(buf->data, &tmpl->ip_hdr, IP_HDR_BYTES);
+    ip_hdr_t *ip_hdr = (ip_hdr_t *)buf->data;
+    ip_hdr->total_len16 = swap16(buf->len);
+    ip_hdr->id16 = swap16(id);
+    ip_hdr->hdr_checksum16 = checksum_finish(tmpl->ip_sum + ip_hdr->total_len16 + ip_hdr->id16);
+    ethernet_out_prebuilt(tmpl->ifindex, buf, &tmpl->eth_hdr);
 }
 
 /**
@@ -199,5 +839,48 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
  *
  */
 void ip_init() {
+    // 每个数据报至少占用一个缓存块，重组表的容量随全局上限确定
+    size_t reasm_max_num = net_config.ip_reasm_mem_limit / IP_REASM_CHUNK_LEN;
+    map_init(&ip_reasm_table, sizeof(ip_reasm_key_t), sizeof(ip_reasm_t), reasm_max_num ? reasm_max_num : 1, 0, NULL, NULL);
+    map_init(&ip_pmtu_table, NET_IP_LEN, sizeof(ip_pmtu_t), net_config.ip_pmtu_max_num, 0, NULL, NULL);
+    ip_reasm_mem = 0;
+    for (ip_reasm_free_num = 0; ip_reasm_free_num < IP_REASM_POOL_NUM; ip_reasm_free_num++)
+        ip_reasm_free[ip_reasm_free_num] = IP_REASM_POOL_NUM - 1 - ip_reasm_free_num;
+    ip_route_init();
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
+}
+
+/**
+ * @brief 释放一个已超时的重组数据报
+ *
+ */
+static void ip_reasm_timeout_fn(void *key, void *value, time_t *timestamp) {
+    ip_reasm_t *reasm = value;
+    if (clock_ms() >= reasm->deadline)
+        ip_reasm_drop(key, reasm);
+}
+
+/**
+ * @brief 删除一个已过期的路径MTU缓存条目，之后恢复以链路MTU探测
+ *
+ */
+static void ip_pmtu_timeout_fn(void *key, void *value, time_t *timestamp) {
+    if (time(NULL) - *timestamp >= net_config.ip_pmtu_timeout_sec) {
+        map_delete(&ip_pmtu_table, key);
+        ip_pmtu_gen++;
+    }
+}
+
+/**
+ * @brief 一次ip轮询，每隔 IP_REASM_SWEEP_MS 释放超时的重组数据报与过期的路径MTU缓存
+ *
+ */
+void ip_poll() {
+    static uint64_t last_poll;
+    uint64_t now = clock_ms();
+    if (now - last_poll < IP_REASM_SWEEP_MS)
+        return;
+    last_poll = now;
+    map_foreach(&ip_reasm_table, ip_reasm_timeout_fn);
+    map_foreach(&ip_pmtu_table, ip_pmtu_timeout_fn);
 }
\ No newline at end of file
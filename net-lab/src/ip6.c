@@ -0,0 +1,188 @@
+#include "ip6.h"
+
+#include "ethernet.h"
+#include "icmp6.h"
+#include "nd.h"
+#include "net.h"
+
+#include <stddef.h>
+
+/**
+ * @brief ipv6上层协议处理程序表
+ *
+ */
+static map_t ip6_table;  // next_header -> net_handler
+
+/**
+ * @brief 当前正在处理的数据报的目的地址，上层据此校验伪首部并选择应答的源地址
+ *
+ */
+uint8_t ip6_in_dst[NET_IP6_LEN];
+/**
+ * @brief 当前正在处理的数据报的跳数限制，邻居发现据此丢弃来自其他链路的报文
+ *
+ */
+uint8_t ip6_in_hop_limit;
+/**
+ * @brief 当前正在处理的数据报的首部长度，含扩展首部，上层发送差错报文时据此恢复首部
+ *
+ */
+uint16_t ip6_in_hdr_len;
+
+/**
+ * @brief 处理一个收到的ipv6数据报
+ *
+ * @param buf 要处理的数据包
+ * @param src_mac 源mac地址
+ */
+void ip6_in(buf_t *buf, uint8_t *src_mac) {
+    // Step1: 检查数据包长度与版本号
+    if (buf->len < IP6_HDR_LEN)
+        return;
+    ip6_hdr_t *ip6_hdr = (ip6_hdr_t *)buf->data;
+    if ((buf->data[0] >> 4) != IP6_VERSION)
+        return;
+    uint16_t payload_len = swap16(ip6_hdr->payload_len16);
+    if (IP6_HDR_LEN + payload_len > buf->len)
+        return;
+    // 去除以太网最小帧长的填充
+    if (buf->len > IP6_HDR_LEN + payload_len)
+        buf_remove_padding(buf, buf->len - IP6_HDR_LEN - payload_len);
+
+    // Step2: 对比目的地址 接收发往本机地址与本网卡所在组播组的数据报，源地址不能是组播地址
+    if (IP6_IS_MULTICAST(ip6_hdr->src_ip))
+        return;
+    if (net_if_lookup6(ip6_hdr->dst_ip) < 0 &&
+        !(IP6_IS_MULTICAST(ip6_hdr->dst_ip) && net_if_group_member6(net_if_rx, ip6_hdr->dst_ip)))
+        return;
+    memcpy(ip6_in_dst, ip6_hdr->dst_ip, NET_IP6_LEN);
+    ip6_in_hop_limit = ip6_hdr->hop_limit;
+
+    // Step3: 跳过逐跳选项、路由与目的选项扩展首部，分片不做重组，直接丢弃
+    uint8_t next_header = ip6_hdr->next_header;
+    uint16_t nh_offset = offsetof(ip6_hdr_t, next_header);  // 最后一个“下一个首部”字段的偏移
+    uint16_t hdr_len = IP6_HDR_LEN;
+    while (next_header == IP6_EXT_HOP_BY_HOP || next_header == IP6_EXT_ROUTING || next_header == IP6_EXT_DEST_OPTS) {
+        if (hdr_len + IP6_EXT_UNIT > buf->len)
+            return;
+        ip6_ext_hdr_t *ext = (ip6_ext_hdr_t *)(buf->data + hdr_len);
+        uint16_t ext_len = (ext->hdr_len + 1) * IP6_EXT_UNIT;
+        if (hdr_len + ext_len > buf->len)
+            return;
+        // 本机不转发，仍有未经过的路由节点的路由首部视为无效
+        if (next_header == IP6_EXT_ROUTING && buf->data[hdr_len + 3] != 0)
+            return;
+        nh_offset = hdr_len;
+        next_header = ext->next_header;
+        hdr_len += ext_len;
+    }
+    if (next_header == IP6_EXT_FRAGMENT)
+        return;
+    ip6_in_hdr_len = hdr_len;
+
+    // Step4: 去掉首部，向上层传递数据包
+    buf_remove_header(buf, hdr_len);
+    net_handler_t *handler = map_get(&ip6_table, &next_header);
+    if (handler) {
+        (*handler)(buf, ip6_hdr->src_ip);
+        return;
+    }
+    // 上层不识别该协议，回复参数问题，指向无法识别的“下一个首部”字段
+    buf_add_header(buf, hdr_len);
+    icmp6_error(buf, ip6_hdr->src_ip, ICMP6_TYPE_PARAM_PROBLEM, ICMP6_CODE_UNKNOWN_NEXT_HEADER, nh_offset);
+}
+
+/**
+ * @brief 以指定的跳数限制发送一个ipv6数据报，不分片，超过链路MTU的数据报被丢弃
+ *
+ * 组播数据报直接发往对应的mac地址；单播数据报的下一跳为直连的目的地址或默认网关，由邻居发现解析mac地址
+ *
+ * @param buf 要处理的包
+ * @param src 源ipv6地址
+ * @param dst 目标ipv6地址
+ * @param next_header 上层协议
+ * @param hop_limit 跳数限制
+ */
+void ip6_out_hop_limit(buf_t *buf, const uint8_t *src, const uint8_t *dst, uint8_t next_header, uint8_t hop_limit) {
+    if (buf->len + IP6_HDR_LEN > net_config.mtu)
+        return;
+    // Step1: 填写首部
+    buf_add_header(buf, IP6_HDR_LEN);
+    ip6_hdr_t *ip6_hdr = (ip6_hdr_t *)buf->data;
+    ip6_hdr->ver_tc_flow32 = swap32((uint32_t)IP6_VERSION << 28);
+    ip6_hdr->payload_len16 = swap16(buf->len - IP6_HDR_LEN);
+    ip6_hdr->next_header = next_header;
+    ip6_hdr->hop_limit = hop_limit;
+    memcpy(ip6_hdr->src_ip, src, NET_IP6_LEN);
+    memcpy(ip6_hdr->dst_ip, dst, NET_IP6_LEN);
+
+    // Step2: 组播数据报从源地址所在网卡直接发出
+    if (IP6_IS_MULTICAST(dst)) {
+        uint8_t mac[NET_MAC_LEN];
+        net_if_group_mac6(dst, mac);
+        int ifindex = net_if_lookup6(src);
+        ethernet_out_if(ifindex < 0 ? 0 : ifindex, buf, mac, NET_PROTOCOL_IPV6);
+        return;
+    }
+
+    // Step3: 选择下一跳，交给邻居发现解析mac地址后发送
+    const uint8_t *next_hop = dst;
+    int ifindex = net_if_select6(dst, NULL);
+    if (ifindex < 0) {
+        static const uint8_t any[NET_IP6_LEN] = {0};
+        if (!memcmp(net_config.gateway6, any, NET_IP6_LEN))
+            return;  // 没有默认网关，无法到达不直连的地址
+        next_hop = net_config.gateway6;
+        ifindex = net_if_select6(next_hop, NULL);
+    }
+    nd_out(ifindex < 0 ? 0 : ifindex, buf, next_hop);
+}
+
+/**
+ * @brief 发送一个ipv6数据报，组播数据报只在本链路内传播
+ *
+ * @param buf 要处理的包
+ * @param src 源ipv6地址
+ * @param dst 目标ipv6地址
+ * @param next_header 上层协议
+ */
+void ip6_out(buf_t *buf, const uint8_t *src, const uint8_t *dst, uint8_t next_header) {
+    ip6_out_hop_limit(buf, src, dst, next_header, IP6_IS_MULTICAST(dst) ? IP6_MULTICAST_HOP_LIMIT : net_config.ttl);
+}
+
+/**
+ * @brief 为发往目的地址的数据报选择源地址：与目的地址直连的网卡地址，
+ * 否则为第一个非链路本地地址，都没有时为主网卡的链路本地地址
+ *
+ * @param dst 目标ipv6地址
+ * @param src 出口参数，选出的源地址
+ */
+void ip6_src_select(const uint8_t *dst, uint8_t *src) {
+    const uint8_t *addr = net_ifs[0].addrs6[0].ip;
+    if (!IP6_IS_MULTICAST(dst) && net_if_select6(dst, &addr) < 0) {
+        for (int i = net_if_num - 1; i >= 0; i--)
+            for (int j = net_ifs[i].addr6_num - 1; j >= 0; j--)
+                if (!IP6_IS_LINK_LOCAL(net_ifs[i].addrs6[j].ip))
+                    addr = net_ifs[i].addrs6[j].ip;
+    }
+    memcpy(src, addr, NET_IP6_LEN);
+}
+
+/**
+ * @brief 注册一个ipv6上层协议
+ *
+ * @param next_header 上层协议号
+ * @param handler 该协议的in处理程序
+ */
+void ip6_add_protocol(uint8_t next_header, net_handler_t handler) {
+    map_set(&ip6_table, &next_header, &handler);
+}
+
+/**
+ * @brief 初始化ipv6协议
+ *
+ */
+void ip6_init() {
+    map_init(&ip6_table, sizeof(uint8_t), sizeof(net_handler_t), 0, 0, NULL, NULL);
+    net_add_protocol(NET_PROTOCOL_IPV6, ip6_in);
+}
@@ -0,0 +1,221 @@
+#include "nd.h"
+
+#include "ethernet.h"
+#include "icmp6.h"
+#include "ip6.h"
+#include "net.h"
+
+#include <stdio.h>
+#include <string.h>
+/**
+ * @brief 邻居缓存，<ipv6,mac>的容器，与arp表共用表项上限与超时时间
+ *
+ */
+map_t nd_table;
+
+/**
+ * @brief 等待邻居通告的数据包，<ipv6,buf_t>的容器
+ *
+ */
+map_t nd_buf;
+
+/**
+ * @brief 打印一条邻居缓存表项
+ *
+ * @param ip 表项的ipv6地址
+ * @param mac 表项的mac地址
+ * @param timestamp 表项的更新时间
+ */
+void nd_entry_print(void *ip, void *mac, time_t *timestamp) {
+    printf("%s | %s | %s\n", ip6tos(ip), mactos(mac), timetos(*timestamp));
+}
+
+/**
+ * @brief 打印整个邻居缓存
+ *
+ */
+void nd_print() {
+    printf("===ND TABLE BEGIN===\n");
+    map_foreach(&nd_table, nd_entry_print);
+    printf("===ND TABLE  END ===\n");
+}
+
+/**
+ * @brief 在txbuf中填写邻居发现报文与链路层地址选项，并计算校验和后发送
+ *
+ * @param ifindex 出口网卡编号
+ * @param src 源ipv6地址
+ * @param dst 目标ipv6地址
+ * @param type 报文类型，邻居请求或邻居通告
+ * @param flags 邻居通告的标志位
+ * @param target 目标地址
+ */
+static void nd_send(int ifindex, const uint8_t *src, const uint8_t *dst, icmp6_type_t type, uint32_t flags, const uint8_t *target) {
+    buf_init(&txbuf, sizeof(nd_msg_t) + sizeof(nd_opt_lla_t));
+    nd_msg_t *msg = (nd_msg_t *)txbuf.data;
+    msg->type = type;
+    msg->code = 0;
+    msg->checksum16 = 0;
+    msg->flags32 = swap32(flags);
+    memcpy(msg->target, target, NET_IP6_LEN);
+    // 邻居请求携带源链路层地址，邻居通告携带目标链路层地址
+    nd_opt_lla_t *opt = (nd_opt_lla_t *)(msg + 1);
+    opt->type = type == ICMP6_TYPE_NEIGHBOR_SOLICIT ? ND_OPT_SRC_LLA : ND_OPT_TARGET_LLA;
+    opt->len = sizeof(nd_opt_lla_t) / IP6_EXT_UNIT;
+    memcpy(opt->mac, net_ifs[ifindex].mac, NET_MAC_LEN);
+    msg->checksum16 = transport_checksum6(NET_PROTOCOL_ICMPV6, &txbuf, src, dst);
+    ip6_out_hop_limit(&txbuf, src, dst, NET_PROTOCOL_ICMPV6, IP6_ND_HOP_LIMIT);
+}
+
+/**
+ * @brief 发送一个邻居请求，发往目标地址的请求节点组播地址
+ *
+ * @param ifindex 出口网卡编号
+ * @param target 想要知道mac地址的ipv6地址
+ */
+void nd_solicit(int ifindex, const uint8_t *target) {
+    // 选择目标所在前缀的网卡地址，不在任何前缀内时用链路本地地址
+    const uint8_t *src = net_ifs[ifindex].addrs6[0].ip;
+    net_if_select6(target, &src);
+    uint8_t group[NET_IP6_LEN];
+    net_if_solicited_node(target, group);
+    nd_send(ifindex, src, group, ICMP6_TYPE_NEIGHBOR_SOLICIT, 0, target);
+}
+
+/**
+ * @brief 发送一个邻居通告，源地址为被通告的本机地址
+ *
+ * @param ifindex 出口网卡编号
+ * @param dst 目标ipv6地址
+ * @param target 被通告的本机地址
+ * @param flags 标志位
+ */
+void nd_advert(int ifindex, const uint8_t *dst, const uint8_t *target, uint32_t flags) {
+    nd_send(ifindex, target, dst, ICMP6_TYPE_NEIGHBOR_ADVERT, flags, target);
+}
+
+/**
+ * @brief 在邻居发现报文的选项中查找链路层地址选项
+ *
+ * @param buf 邻居发现报文
+ * @param type 选项类型
+ * @return uint8_t* 选项中的mac地址，没有该选项或选项无效时为NULL
+ */
+static uint8_t *nd_find_lla(buf_t *buf, uint8_t type) {
+    size_t offset = sizeof(nd_msg_t);
+    while (offset + 2 <= buf->len) {
+        nd_opt_lla_t *opt = (nd_opt_lla_t *)(buf->data + offset);
+        size_t len = opt->len * IP6_EXT_UNIT;
+        if (len == 0 || offset + len > buf->len)
+            return NULL;  // 长度为0的选项使报文无效
+        if (opt->type == type && len >= sizeof(nd_opt_lla_t))
+            return opt->mac;
+        offset += len;
+    }
+    return NULL;
+}
+
+/**
+ * @brief 更新邻居缓存，并发送等待该邻居的数据包
+ *
+ * @param ip 邻居的ipv6地址
+ * @param mac 邻居的mac地址
+ */
+static void nd_update(uint8_t *ip, uint8_t *mac) {
+    map_set(&nd_table, ip, mac);
+    buf_t *cached_buf = map_get(&nd_buf, ip);
+    if (cached_buf != NULL) {
+        ethernet_out_if(net_if_rx, cached_buf, mac, NET_PROTOCOL_IPV6);
+        map_delete(&nd_buf, ip);
+    }
+}
+
+/**
+ * @brief 处理一个收到的邻居请求或邻居通告，校验和已由icmp6_in检查
+ *
+ * @param buf 要处理的数据包
+ * @param src_ip 源ipv6地址
+ */
+void nd_in(buf_t *buf, uint8_t *src_ip) {
+    // 只接受来自本链路的报文
+    if (buf->len < sizeof(nd_msg_t) || ip6_in_hop_limit != IP6_ND_HOP_LIMIT)
+        return;
+    nd_msg_t *msg = (nd_msg_t *)buf->data;
+    if (msg->code != 0 || IP6_IS_MULTICAST(msg->target))
+        return;
+    static const uint8_t any[NET_IP6_LEN] = {0};
+    if (msg->type == ICMP6_TYPE_NEIGHBOR_SOLICIT) {
+        // 邻居请求：目标必须是本机地址，据源链路层地址学习请求方
+        if (net_if_lookup6(msg->target) < 0)
+            return;
+        uint8_t *mac = nd_find_lla(buf, ND_OPT_SRC_LLA);
+        uint8_t target[NET_IP6_LEN];
+        memcpy(target, msg->target, NET_IP6_LEN);
+        if (!memcmp(src_ip, any, NET_IP6_LEN)) {
+            // 重复地址检测发出的请求，通告发往所有节点组
+            static const uint8_t all_nodes[NET_IP6_LEN] = {0xff, 0x02, [15] = 0x01};
+            if (mac)
+                return;  // 未指定源地址的请求不能携带源链路层地址
+            nd_advert(net_if_rx, all_nodes, target, ND_NA_FLAG_OVERRIDE);
+            return;
+        }
+        if (mac)
+            nd_update(src_ip, mac);
+        nd_advert(net_if_rx, src_ip, target, ND_NA_FLAG_SOLICITED | ND_NA_FLAG_OVERRIDE);
+    } else if (msg->type == ICMP6_TYPE_NEIGHBOR_ADVERT) {
+        // 邻居通告：据目标链路层地址更新邻居缓存
+        uint32_t flags = swap32(msg->flags32);
+        if ((flags & ND_NA_FLAG_SOLICITED) && IP6_IS_MULTICAST(ip6_in_dst))
+            return;
+        uint8_t *mac = nd_find_lla(buf, ND_OPT_TARGET_LLA);
+        if (mac)
+            nd_update(msg->target, mac);
+    }
+}
+
+/**
+ * @brief 处理一个要发送的ipv6数据包
+ *
+ * @param ifindex 出口网卡编号
+ * @param buf 要处理的数据包
+ * @param next_hop 下一跳的ipv6地址
+ */
+void nd_out(int ifindex, buf_t *buf, const uint8_t *next_hop) {
+    uint8_t *dst_mac = map_get(&nd_table, next_hop);
+    if (dst_mac != NULL) {
+        ethernet_out_if(ifindex, buf, dst_mac, NET_PROTOCOL_IPV6);
+        return;
+    }
+    // 已在等待邻居通告，不重复发送邻居请求
+    if (map_get(&nd_buf, next_hop) != NULL)
+        return;
+    // 缓存该数据包后再请求，邻居请求会复用txbuf
+    uint8_t ip[NET_IP6_LEN];
+    memcpy(ip, next_hop, NET_IP6_LEN);
+    map_set(&nd_buf, ip, buf);
+    nd_solicit(ifindex, ip);
+}
+
+/**
+ * @brief 查询邻居缓存
+ *
+ * @param ip 要查询的ipv6地址
+ * @return uint8_t* 对应的mac地址，未解析为NULL
+ */
+uint8_t *nd_lookup(const uint8_t *ip) {
+    return map_get(&nd_table, ip);
+}
+
+/**
+ * @brief 初始化邻居发现
+ *
+ */
+void nd_init() {
+    map_init(&nd_table, NET_IP6_LEN, NET_MAC_LEN, net_config.arp_max_num, net_config.arp_timeout_sec, NULL, NULL);
+    map_init(&nd_buf, NET_IP6_LEN, sizeof(buf_t), 0, net_config.arp_min_interval_sec, NULL, buf_copy);
+    // 为每块网卡上的每个地址发送未经请求的邻居通告，通告本机的mac地址
+    static const uint8_t all_nodes[NET_IP6_LEN] = {0xff, 0x02, [15] = 0x01};
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr6_num; j++)
+            nd_advert(i, all_nodes, net_ifs[i].addrs6[j].ip, ND_NA_FLAG_OVERRIDE);
+}
@@ -4,7 +4,11 @@
 #include "driver.h"
 #include "ethernet.h"
 #include "icmp.h"
+#include "icmp6.h"
+#include "igmp.h"
 #include "ip.h"
+#include "ip6.h"
+#include "nd.h"
 #include "tcp.h"
 #include "udp.h"
 
@@ -26,23 +30,434 @@ uint8_t net_if_mac[NET_MAC_LEN] = NET_IF_MAC;
  */
 uint8_t net_if_ip[NET_IP_LEN] = NET_IF_IP;
 
+/**
+ * @brief 网卡表，0号为主网卡，由 net_if_mac 与 net_if_ip 生成
+ *
+ */
+net_if_t net_ifs[NET_IF_MAX_NUM];
+int net_if_num;
+
+/**
+ * @brief 当前正在处理的数据包是从哪块网卡收到的
+ *
+ */
+int net_if_rx;
+
 /**
  * @brief 网卡接收和发送缓冲区
  *
  */
 buf_t rxbuf, txbuf;  // 一个buf足够单线程使用
 
+/**
+ * @brief 由网卡mac地址按修改的 EUI-64 格式生成链路本地地址 fe80::/64，作为网卡的第一个ipv6地址
+ *
+ */
+static void net_if_link_local(net_if_t *nif) {
+    net_if_addr6_t *addr = &nif->addrs6[0];
+    memset(addr, 0, sizeof(net_if_addr6_t));
+    addr->ip[0] = 0xfe;
+    addr->ip[1] = 0x80;
+    addr->ip[8] = nif->mac[0] ^ 0x02;
+    addr->ip[9] = nif->mac[1];
+    addr->ip[10] = nif->mac[2];
+    addr->ip[11] = 0xff;
+    addr->ip[12] = 0xfe;
+    addr->ip[13] = nif->mac[3];
+    addr->ip[14] = nif->mac[4];
+    addr->ip[15] = nif->mac[5];
+    addr->prefix_len = 64;
+    nif->addr6_num = 1;
+}
+
+/**
+ * @brief 以 net_if_mac、net_if_ip 与运行时配置生成主网卡，已生成时什么也不做
+ *
+ */
+void net_if_init() {
+    if (net_if_num)
+        return;
+    net_if_t *nif = &net_ifs[net_if_num++];
+    memset(nif, 0, sizeof(net_if_t));
+    strcpy(nif->name, net_config.if_name);
+    memcpy(nif->mac, net_if_mac, NET_MAC_LEN);
+    memcpy(nif->addrs[0].ip, net_if_ip, NET_IP_LEN);
+    memcpy(nif->addrs[0].netmask, net_config.netmask, NET_IP_LEN);
+    memcpy(&nif->addrs[1], net_config.addrs, net_config.addr_num * sizeof(net_if_addr_t));
+    nif->addr_num = 1 + net_config.addr_num;
+    memcpy(nif->groups, net_config.groups, sizeof(nif->groups));
+    nif->group_num = net_config.group_num;
+    net_if_link_local(nif);
+    memcpy(&nif->addrs6[1], net_config.addrs6, net_config.addr6_num * sizeof(net_if_addr6_t));
+    nif->addr6_num += net_config.addr6_num;
+}
+
+/**
+ * @brief 添加一块网卡，在 net_init() 之前调用时随协议栈一起打开
+ *
+ * @param name 网卡名，为NULL时按网卡的首个地址选择
+ * @param mac 网卡的mac地址
+ * @return int 网卡编号，网卡表已满时为-1
+ */
+int net_if_add(const char *name, const uint8_t *mac) {
+    net_if_init();
+    if (net_if_num == NET_IF_MAX_NUM)
+        return -1;
+    net_if_t *nif = &net_ifs[net_if_num];
+    memset(nif, 0, sizeof(net_if_t));
+    if (name)
+        snprintf(nif->name, NET_IF_NAME_LEN, "%s", name);
+    memcpy(nif->mac, mac, NET_MAC_LEN);
+    net_if_link_local(nif);
+    return net_if_num++;
+}
+
+/**
+ * @brief 为网卡添加一个ip地址，同时添加到该网段的直连路由
+ *
+ * @param ifindex 网卡编号
+ * @param ip ip地址
+ * @param netmask 子网掩码
+ * @return int 成功为0，网卡不存在、地址已存在或地址已满时为-1
+ */
+int net_if_addr_add(int ifindex, const uint8_t *ip, const uint8_t *netmask) {
+    net_if_init();
+    if (ifindex < 0 || ifindex >= net_if_num || net_if_lookup(ip) >= 0)
+        return -1;
+    net_if_t *nif = &net_ifs[ifindex];
+    if (nif->addr_num == NET_IF_ADDR_MAX_NUM)
+        return -1;
+    net_if_addr_t *addr = &nif->addrs[nif->addr_num++];
+    memcpy(addr->ip, ip, NET_IP_LEN);
+    memcpy(addr->netmask, netmask, NET_IP_LEN);
+    uint8_t any[NET_IP_LEN] = {0};
+    ip_route_add(addr->ip, addr->netmask, any, 0);
+    return 0;
+}
+
+/**
+ * @brief 查找配置了该ip地址的网卡
+ *
+ * @param ip ip地址
+ * @return int 网卡编号，不是本机地址时为-1
+ */
+int net_if_lookup(const uint8_t *ip) {
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr_num; j++)
+            if (!memcmp(net_ifs[i].addrs[j].ip, ip, NET_IP_LEN))
+                return i;
+    return -1;
+}
+
+/**
+ * @brief 判断地址是否在网卡地址的网段内
+ *
+ */
+static inline int net_if_addr_match(const net_if_addr_t *addr, const uint8_t *ip) {
+    for (int k = 0; k < NET_IP_LEN; k++)
+        if ((addr->ip[k] ^ ip[k]) & addr->netmask[k])
+            return 0;
+    return 1;
+}
+
+/**
+ * @brief 为直连地址选择出口网卡与源地址：取网段包含该地址的第一个网卡地址
+ *
+ * @param ip 直连的目标ip地址，如路由选出的下一跳
+ * @param src 出口参数，可为NULL，选出的源地址
+ * @return int 网卡编号，不在任何网卡的网段内时取主网卡与主地址
+ */
+int net_if_select(const uint8_t *ip, const uint8_t **src) {
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr_num; j++)
+            if (net_if_addr_match(&net_ifs[i].addrs[j], ip)) {
+                if (src)
+                    *src = net_ifs[i].addrs[j].ip;
+                return i;
+            }
+    if (src)
+        *src = net_if_ip;
+    return 0;
+}
+
+/**
+ * @brief 判断地址是否是受限广播地址或某个网卡地址所在网段的定向广播地址
+ *
+ * @param ip ip地址
+ * @return int 是广播地址为1，否则为0
+ */
+int net_if_is_broadcast(const uint8_t *ip) {
+    static const uint8_t limited[NET_IP_LEN] = {0xff, 0xff, 0xff, 0xff};
+    if (!memcmp(ip, limited, NET_IP_LEN))
+        return 1;
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr_num; j++) {
+            const net_if_addr_t *addr = &net_ifs[i].addrs[j];
+            if (addr->netmask[NET_IP_LEN - 1] >= 0xfe)
+                continue;  // 31位与32位前缀的网段没有广播地址
+            int k;
+            for (k = 0; k < NET_IP_LEN; k++)
+                if ((ip[k] | addr->netmask[k]) != 0xff)
+                    break;
+            if (k == NET_IP_LEN && net_if_addr_match(addr, ip))
+                return 1;
+        }
+    return 0;
+}
+
+/**
+ * @brief 所有主机组 224.0.0.1，每块网卡都隐含加入
+ *
+ */
+static const uint8_t net_all_hosts_group[NET_IP_LEN] = {224, 0, 0, 1};
+
+/**
+ * @brief 查找网卡加入的组播组
+ *
+ * @return int 组的下标，未加入为-1
+ */
+static int net_if_group_find(net_if_t *nif, const uint8_t *group) {
+    for (int i = 0; i < nif->group_num; i++)
+        if (!memcmp(nif->groups[i], group, NET_IP_LEN))
+            return i;
+    return -1;
+}
+
+/**
+ * @brief 网卡加入组播组，并更新驱动的mac地址过滤
+ *
+ * @param ifindex 网卡编号
+ * @param group 组播地址
+ * @return int 成功为0，网卡不存在、不是组播地址、已加入或组数已满时为-1
+ */
+int net_if_group_add(int ifindex, const uint8_t *group) {
+    net_if_init();
+    if (ifindex < 0 || ifindex >= net_if_num || (group[0] & 0xf0) != 0xe0)
+        return -1;
+    net_if_t *nif = &net_ifs[ifindex];
+    if (net_if_group_find(nif, group) >= 0 || nif->group_num == NET_IF_GROUP_MAX_NUM)
+        return -1;
+    memcpy(nif->groups[nif->group_num++], group, NET_IP_LEN);
+    driver_update_filter(ifindex);
+    return 0;
+}
+
+/**
+ * @brief 网卡退出组播组，并更新驱动的mac地址过滤
+ *
+ * @param ifindex 网卡编号
+ * @param group 组播地址
+ * @return int 成功为0，未加入该组时为-1
+ */
+int net_if_group_delete(int ifindex, const uint8_t *group) {
+    if (ifindex < 0 || ifindex >= net_if_num)
+        return -1;
+    net_if_t *nif = &net_ifs[ifindex];
+    int i = net_if_group_find(nif, group);
+    if (i < 0)
+        return -1;
+    memcpy(nif->groups[i], nif->groups[--nif->group_num], NET_IP_LEN);
+    driver_update_filter(ifindex);
+    return 0;
+}
+
+/**
+ * @brief 判断网卡是否接收发往该组播地址的数据报
+ *
+ * @param ifindex 网卡编号
+ * @param ip 组播地址
+ * @return int 接收为1，否则为0
+ */
+int net_if_group_member(int ifindex, const uint8_t *ip) {
+    net_if_t *nif = &net_ifs[ifindex];
+    return nif->allmulti || !memcmp(ip, net_all_hosts_group, NET_IP_LEN) || net_if_group_find(nif, ip) >= 0;
+}
+
+/**
+ * @brief 组播地址对应的以太网mac地址：01:00:5e 加上地址的低23位
+ *
+ * @param group 组播地址
+ * @param mac 出口参数，mac地址
+ */
+void net_if_group_mac(const uint8_t *group, uint8_t *mac) {
+    mac[0] = 0x01;
+    mac[1] = 0x00;
+    mac[2] = 0x5e;
+    mac[3] = group[1] & 0x7f;
+    mac[4] = group[2];
+    mac[5] = group[3];
+}
+
+/**
+ * @brief 判断网卡是否接收发往该mac地址的帧：本网卡地址、广播地址与已加入的组播组的地址
+ *
+ * @param ifindex 网卡编号
+ * @param mac 目的mac地址
+ * @return int 接收为1，否则为0
+ */
+int net_if_mac_accept(int ifindex, const uint8_t *mac) {
+    static const uint8_t broadcast[NET_MAC_LEN] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
+    net_if_t *nif = &net_ifs[ifindex];
+    if (!memcmp(mac, nif->mac, NET_MAC_LEN) || !memcmp(mac, broadcast, NET_MAC_LEN))
+        return 1;
+    if (!(mac[0] & 0x01))
+        return 0;
+    if (nif->allmulti)
+        return 1;
+    uint8_t group_mac[NET_MAC_LEN];
+    net_if_group_mac(net_all_hosts_group, group_mac);
+    if (!memcmp(mac, group_mac, NET_MAC_LEN))
+        return 1;
+    for (int i = 0; i < nif->group_num; i++) {
+        net_if_group_mac(nif->groups[i], group_mac);
+        if (!memcmp(mac, group_mac, NET_MAC_LEN))
+            return 1;
+    }
+#ifdef IPV6
+    // ipv6的所有节点组与各地址的请求节点组
+    static const uint8_t all_nodes_mac[NET_MAC_LEN] = {0x33, 0x33, 0, 0, 0, 0x01};
+    if (!memcmp(mac, all_nodes_mac, NET_MAC_LEN))
+        return 1;
+    uint8_t group[NET_IP6_LEN];
+    for (int i = 0; i < nif->addr6_num; i++) {
+        net_if_solicited_node(nif->addrs6[i].ip, group);
+        net_if_group_mac6(group, group_mac);
+        if (!memcmp(mac, group_mac, NET_MAC_LEN))
+            return 1;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * @brief 为网卡添加一个ipv6地址
+ *
+ * @param ifindex 网卡编号
+ * @param ip ipv6地址
+ * @param prefix_len 前缀长度
+ * @return int 成功为0，网卡不存在、地址已存在或地址已满时为-1
+ */
+int net_if_addr6_add(int ifindex, const uint8_t *ip, uint8_t prefix_len) {
+    net_if_init();
+    if (ifindex < 0 || ifindex >= net_if_num || prefix_len > 128 || net_if_lookup6(ip) >= 0)
+        return -1;
+    net_if_t *nif = &net_ifs[ifindex];
+    if (nif->addr6_num == NET_IF_ADDR6_MAX_NUM)
+        return -1;
+    net_if_addr6_t *addr = &nif->addrs6[nif->addr6_num++];
+    memcpy(addr->ip, ip, NET_IP6_LEN);
+    addr->prefix_len = prefix_len;
+    return 0;
+}
+
+/**
+ * @brief 查找配置了该ipv6地址的网卡
+ *
+ * @param ip ipv6地址
+ * @return int 网卡编号，不是本机地址时为-1
+ */
+int net_if_lookup6(const uint8_t *ip) {
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr6_num; j++)
+            if (!memcmp(net_ifs[i].addrs6[j].ip, ip, NET_IP6_LEN))
+                return i;
+    return -1;
+}
+
+/**
+ * @brief 判断地址是否在网卡ipv6地址的前缀内
+ *
+ */
+static inline int net_if_addr6_match(const net_if_addr6_t *addr, const uint8_t *ip) {
+    int bytes = addr->prefix_len / 8, bits = addr->prefix_len % 8;
+    if (memcmp(addr->ip, ip, bytes))
+        return 0;
+    return bits == 0 || !((addr->ip[bytes] ^ ip[bytes]) & (0xff << (8 - bits)));
+}
+
+/**
+ * @brief 为直连的ipv6地址选择出口网卡与源地址：取前缀包含该地址的第一个网卡地址
+ *
+ * @param ip 目标ipv6地址
+ * @param src 出口参数，可为NULL，选出的源地址
+ * @return int 网卡编号，不在任何网卡的前缀内时为-1
+ */
+int net_if_select6(const uint8_t *ip, const uint8_t **src) {
+    for (int i = 0; i < net_if_num; i++)
+        for (int j = 0; j < net_ifs[i].addr6_num; j++)
+            if (net_if_addr6_match(&net_ifs[i].addrs6[j], ip)) {
+                if (src)
+                    *src = net_ifs[i].addrs6[j].ip;
+                return i;
+            }
+    return -1;
+}
+
+/**
+ * @brief ipv6地址的请求节点组播地址 ff02::1:ffXX:XXXX，邻居请求发往该地址
+ *
+ * @param ip ipv6地址
+ * @param group 出口参数，组播地址
+ */
+void net_if_solicited_node(const uint8_t *ip, uint8_t *group) {
+    static const uint8_t prefix[13] = {0xff, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0x01, 0xff};
+    memcpy(group, prefix, sizeof(prefix));
+    memcpy(group + sizeof(prefix), ip + sizeof(prefix), NET_IP6_LEN - sizeof(prefix));
+}
+
+/**
+ * @brief 判断网卡是否接收发往该ipv6组播地址的数据报：所有节点组与本网卡各地址的请求节点组
+ *
+ * @param ifindex 网卡编号
+ * @param ip ipv6组播地址
+ * @return int 接收为1，否则为0
+ */
+int net_if_group_member6(int ifindex, const uint8_t *ip) {
+    static const uint8_t all_nodes[NET_IP6_LEN] = {0xff, 0x02, [15] = 0x01};
+    net_if_t *nif = &net_ifs[ifindex];
+    if (nif->allmulti || !memcmp(ip, all_nodes, NET_IP6_LEN))
+        return 1;
+    uint8_t group[NET_IP6_LEN];
+    for (int i = 0; i < nif->addr6_num; i++) {
+        net_if_solicited_node(nif->addrs6[i].ip, group);
+        if (!memcmp(ip, group, NET_IP6_LEN))
+            return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief ipv6组播地址对应的以太网mac地址：33:33 加上地址的低32位
+ *
+ * @param group ipv6组播地址
+ * @param mac 出口参数，mac地址
+ */
+void net_if_group_mac6(const uint8_t *group, uint8_t *mac) {
+    mac[0] = 0x33;
+    mac[1] = 0x33;
+    memcpy(mac + 2, group + NET_IP6_LEN - 4, 4);
+}
+
 /**
  * @brief 初始化协议栈
  *
  */
 int net_init() {
     map_init(&net_table, sizeof(uint16_t), sizeof(net_handler_t), 0, 0, NULL, NULL);
+    net_if_init();
     if (driver_open() == -1)
         return -1;
     ethernet_init();
     arp_init();
     ip_init();
+#ifdef IGMP
+    igmp_init();
+#endif
+#ifdef IPV6
+    ip6_init();
+    nd_init();
+    icmp6_init();
+#endif
 #ifdef ICMP
     icmp_init();
 #endif
@@ -88,4 +503,11 @@ int net_in(buf_t *buf, uint16_t protocol, uint8_t *src) {
  */
 void net_poll() {
     ethernet_poll();
+    ip_poll();
+#ifdef IGMP
+    igmp_poll();
+#endif
+#ifdef TCP
+    tcp_poll();
+#endif
 }
\ No newline at end of file
@@ -0,0 +1,26 @@
+#include "utils.h"
+
+#include <stdio.h>
+
+/**
+ * @brief 生成随机字节，用作协议栈的密钥
+ * 优先读取 /dev/urandom，不可用时（如 Windows）退化为以微秒时钟为种子的 xorshift
+ *
+ * @param buf 随机字节存放的位置
+ * @param len 字节数
+ */
+void random_bytes(uint8_t *buf, size_t len) {
+    size_t n = 0;
+    FILE *f = fopen("/dev/urandom", "rb");
+    if (f) {
+        n = fread(buf, 1, len, f);
+        fclose(f);
+    }
+    uint64_t x = clock_us() ^ (uintptr_t)buf;
+    for (; n < len; n++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        buf[n] = x >> 32;
+    }
+}
@@ -2,20 +2,75 @@
 
 #include "icmp.h"
 #include "ip.h"
+#include "ip6.h"
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 /**
- * @brief TCP 处理程序表
+ * @brief TCP 监听者表
  *
  */
-map_t tcp_handler_table;  // dst-port -> handler
+static map_t tcp_listener_table;  // dst-port -> tcp_listener
 /**
- * @brief TCP 连接表
+ * @brief TCP 连接池，已分配的连接按四元组散列到哈希桶中，并挂在所属本地端口的链表上
  *
  */
-static map_t tcp_conn_table;  // [src_ip, src_port, dst_port] -> tcp_conn
+static tcp_conn_t tcp_conn_pool[TCP_MAX_CONN_NUM];
+static size_t tcp_conn_pool_top;                       // 曾经分配过的最高位置，遍历连接时以此为界
+static tcp_conn_t *tcp_conn_free_list;                 // 已释放、可以复用的位置
+static tcp_conn_t *tcp_conn_hash[TCP_CONN_HASH_SIZE];  // hash([src_ip, src_port, dst_ip, dst_port]) -> tcp_conn 链表
+static tcp_conn_t *tcp_port_conns[UINT16_MAX + 1];     // dst_port -> tcp_conn 链表
+/**
+ * @brief TCP 收发缓冲区池，发送队列、乱序队列与接收缓冲区共用，
+ * 仅在连接存在未确认、乱序或未读取的数据时分配，不再需要时归还
+ *
+ */
+typedef union tcp_buf_slot {
+    tcp_txq_t txq;
+    tcp_ooo_t ooo;
+    tcp_rxq_t rxq;
+    union tcp_buf_slot *next;  // 空闲时为空闲链表中的下一个位置
+} tcp_buf_slot_t;
+static tcp_buf_slot_t tcp_buf_pool[TCP_BUF_POOL_NUM];
+static size_t tcp_buf_pool_top;             // 曾经分配过的最高位置
+static tcp_buf_slot_t *tcp_buf_free_list;  // 已归还、可以复用的位置
+/**
+ * @brief TCP 计时轮，每个槽对应 TCP_TIMER_INTERVAL_MS，挂着最早的计时器在该刻度到期的连接，
+ * 轮询时只检查经过的槽，不再遍历整个连接池
+ *
+ */
+static tcp_conn_t *tcp_timer_wheel[TCP_TIMER_WHEEL_SIZE];
+static uint64_t tcp_timer_tick;  // 已处理到的刻度
+/**
+ * @brief 正在调用可读回调的连接，回调中读取数据不单独发送窗口更新，由随后的 ACK 携带
+ *
+ */
+static tcp_conn_t *tcp_reading_conn;
+
+/**
+ * @brief 所有端口上被动打开、尚未完成握手的半连接个数
+ *
+ */
+static size_t tcp_half_open_num;
+/**
+ * @brief 生成 SYN cookie 与连接表散列的 SipHash 密钥
+ *
+ */
+static uint8_t tcp_secret[16];
+/**
+ * @brief 共用同一密钥的各类哈希的域分隔标签
+ *
+ */
+enum { TCP_HASH_CONN, TCP_HASH_COOKIE };
+/**
+ * @brief SYN cookie 可编码的 MSS 取值
+ *
+ */
+static const uint16_t tcp_cookie_mss_table[] = {TCP_PEER_DEFAULT_MSS, 1220, 1440, TCP_DEFAULT_MSS};
+
+static void tcp_out_seq(tcp_conn_t *tcp_conn, buf_t *buf, uint32_t seq, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, uint8_t flags);
 
 /* =============================== TOOLS =============================== */
 
@@ -36,75 +91,1242 @@ size_t bytes_in_flight(size_t len, uint8_t flags) {
 }
 
 /**
- * @brief 生成 TCP 连接的初始随机序列号（ISN）
+ * @brief 重置 TCP 连接
+ */
+void tcp_rst(tcp_conn_t *tcp_conn) {
+    memset(tcp_conn, 0, offsetof(tcp_conn_t, key));
+    tcp_conn->state = TCP_STATE_LISTEN;
+    tcp_conn->mss = TCP_PEER_DEFAULT_MSS;
+    tcp_conn->rto = TCP_RETRANSMISSON_TIMEOUT * 1000;
+}
+
+/**
+ * @brief 按到对端的路径MTU计算最大报文段长度，路径MTU缓存变化后才重新查询
  *
+ * @param tcp_conn  当前 TCP 连接
+ * @return uint16_t 路径MTU扣除 IP 与 TCP 首部，不超过本端 MSS
  */
-static inline uint32_t tcp_generate_initial_seq() {
-    return rand() % UINT32_MAX;
+static inline uint16_t tcp_path_mss(tcp_conn_t *tcp_conn) {
+    if (tcp_conn->pmtu_gen != ip_pmtu_gen) {
+        // ipv6 不缓存路径MTU，按链路MTU计算
+        uint16_t mss = tcp_conn->key.v6 ? net_config.mtu - IP6_HDR_LEN - sizeof(tcp_hdr_t) : ip_pmtu(tcp_conn->key.remote_ip) - IP_HDR_BYTES - sizeof(tcp_hdr_t);
+        tcp_conn->path_mss = mss < TCP_DEFAULT_MSS ? mss : TCP_DEFAULT_MSS;
+        tcp_conn->pmtu_gen = ip_pmtu_gen;
+    }
+    return tcp_conn->path_mss;
 }
 
 /**
- * @brief 重置 TCP 连接
+ * @brief 计算发送数据时每个报文段的最大负载长度
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @return size_t   对端 MSS 与路径 MSS 的较小值，扣除每个报文段都携带的时间戳选项
  */
-void tcp_rst(tcp_conn_t *tcp_conn) {
-    memset(tcp_conn, 0, sizeof(tcp_conn_t));
-    tcp_conn->state = TCP_STATE_LISTEN;
+static inline size_t tcp_send_mss(tcp_conn_t *tcp_conn) {
+    size_t mss = tcp_conn->mss < tcp_path_mss(tcp_conn) ? tcp_conn->mss : tcp_path_mss(tcp_conn);
+    if (tcp_conn->ts_ok)
+        mss -= TCP_OPT_TIMESTAMP_LEN;
+    return mss;
 }
 
 /**
- * @brief 生成标识一个 TCP 连接的三元组键
+ * @brief 计算本端要通告的接收窗口
  *
- * @param ip        源 IP 地址
- * @param src_port  源端口号
- * @param dst_port  目标端口号
+ * @param tcp_conn  当前 TCP 连接
+ * @return uint32_t 接收窗口（字节）
+ */
+static inline uint32_t tcp_rcv_window(tcp_conn_t *tcp_conn) {
+    if (tcp_conn->readable_handler) {
+        // 使用接收缓冲区时只通告剩余空间，应用程序读取缓慢时对端随之放慢
+        return tcp_conn->rxq ? TCP_RXQ_BUF_LEN - tcp_conn->rxq->len : TCP_RXQ_BUF_LEN;
+    }
+    return tcp_conn->wscale_ok ? TCP_RCV_WINDOW : TCP_MAX_WINDOW_SIZE;
+}
+
+/**
+ * @brief 获取本端时间戳选项的时钟值
+ *
+ */
+static inline uint32_t tcp_ts_now() {
+    return (uint32_t)clock_ms();
+}
+
+/**
+ * @brief 根据一个新的 RTT 样本更新平滑往返时间与重传超时时间（RFC 6298）
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param rtt       RTT 样本（毫秒）
+ */
+static void tcp_rtt_update(tcp_conn_t *tcp_conn, uint32_t rtt) {
+    if (tcp_conn->srtt == 0) {
+        tcp_conn->srtt = rtt ? rtt : 1;
+        tcp_conn->rttvar = rtt / 2;
+    } else {
+        uint32_t delta = tcp_conn->srtt > rtt ? tcp_conn->srtt - rtt : rtt - tcp_conn->srtt;
+        tcp_conn->rttvar = (3 * tcp_conn->rttvar + delta) / 4;
+        tcp_conn->srtt = (7 * tcp_conn->srtt + rtt) / 8;
+    }
+    uint32_t rto = tcp_conn->srtt + (4 * tcp_conn->rttvar > TCP_TIMER_INTERVAL_MS ? 4 * tcp_conn->rttvar : TCP_TIMER_INTERVAL_MS);
+    if (rto < TCP_MIN_RTO_MS)
+        rto = TCP_MIN_RTO_MS;
+    if (rto > TCP_MAX_RTO_MS)
+        rto = TCP_MAX_RTO_MS;
+    tcp_conn->rto = rto;
+}
+
+/**
+ * @brief 生成标识一个 TCP 连接的四元组键
+ *
+ * @param remote_ip     对端 IP 地址
+ * @param remote_port   对端端口号
+ * @param local_ip      本端 IP 地址
+ * @param host_port     本地端口号
+ * @param v6            是否为 ipv6 地址
  * @return tcp_key_t
  */
-static inline tcp_key_t generate_tcp_key(uint8_t remote_ip[NET_IP_LEN], uint16_t remote_port, uint16_t host_port) {
+static inline tcp_key_t generate_tcp_key(const uint8_t *remote_ip, uint16_t remote_port, const uint8_t *local_ip, uint16_t host_port, uint8_t v6) {
     tcp_key_t key;
-    memcpy(key.remote_ip, remote_ip, NET_IP_LEN);
+    memset(&key, 0, sizeof(tcp_key_t));  // 键整体参与比较与哈希，ipv4 地址之后补0
+    memcpy(key.remote_ip, remote_ip, v6 ? NET_IP6_LEN : NET_IP_LEN);
+    memcpy(key.local_ip, local_ip, v6 ? NET_IP6_LEN : NET_IP_LEN);
     key.remote_port = remote_port;
     key.host_port = host_port;
+    key.v6 = v6;
     return key;
 }
 
 /**
- * @brief 根据指定的 IP 和端口信息查找或创建 TCP 连接
+ * @brief 计算连接键所在的哈希桶
+ *
+ * @param key       连接的键
+ * @return size_t   哈希桶下标
+ */
+static inline size_t tcp_key_hash(const tcp_key_t *key) {
+    const uint32_t *local = (const uint32_t *)key->local_ip, *remote = (const uint32_t *)key->remote_ip;
+    uint32_t words[] = {TCP_HASH_CONN, local[0], local[1], local[2], local[3], remote[0], remote[1], remote[2], remote[3], ((uint32_t)key->remote_port << 16) | key->host_port};
+    return siphash24(tcp_secret, words, sizeof(words)) & (TCP_CONN_HASH_SIZE - 1);
+}
+
+/**
+ * @brief 在连接表中查找一个连接
+ *
+ * @param key           连接的键
+ * @return tcp_conn_t*  找不到为 NULL
+ */
+static tcp_conn_t *tcp_conn_lookup(const tcp_key_t *key) {
+    for (tcp_conn_t *tcp_conn = tcp_conn_hash[tcp_key_hash(key)]; tcp_conn; tcp_conn = tcp_conn->hash_next)
+        if (!memcmp(&tcp_conn->key, key, sizeof(tcp_key_t)))
+            return tcp_conn;
+    return NULL;
+}
+
+/**
+ * @brief 计算连接最早到期的计时器：TIME_WAIT、SYN 重传、延迟确认、重传与坚持计时器
  *
- * @param remote_ip
- * @param remote_port
- * @param host_port
+ * @param tcp_conn  当前 TCP 连接
+ * @return uint64_t 到期时间（毫秒），没有计时器时为0
+ */
+static uint64_t tcp_conn_deadline(tcp_conn_t *tcp_conn) {
+    if (tcp_conn->state == TCP_STATE_TIME_WAIT)
+        return tcp_conn->time_wait_due;
+    if (tcp_conn->state == TCP_STATE_SYN_SENT || (tcp_conn->state == TCP_STATE_SYN_RECEIVED && tcp_conn->syn_due))
+        return tcp_conn->syn_due;
+    uint64_t due = tcp_conn->ack_pending ? tcp_conn->ack_due : 0;
+    if (tcp_conn->persist_due && (!due || tcp_conn->persist_due < due))
+        due = tcp_conn->persist_due;
+    if (tcp_conn->txq && tcp_conn->una != tcp_conn->seq) {
+        uint64_t rto = (uint64_t)tcp_conn->rto << tcp_conn->txq->backoff;
+        uint64_t rto_due = tcp_conn->txq->rto_time + (rto < TCP_MAX_RTO_MS ? rto : TCP_MAX_RTO_MS);
+        if (!due || rto_due < due)
+            due = rto_due;
+    }
+    return due;
+}
+
+/**
+ * @brief 将连接从计时轮中摘下
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+static void tcp_timer_unlink(tcp_conn_t *tcp_conn) {
+    if (!tcp_conn->timer_due)
+        return;
+    if (tcp_conn->timer_prev)
+        tcp_conn->timer_prev->timer_next = tcp_conn->timer_next;
+    else
+        tcp_timer_wheel[tcp_conn->timer_slot] = tcp_conn->timer_next;
+    if (tcp_conn->timer_next)
+        tcp_conn->timer_next->timer_prev = tcp_conn->timer_prev;
+    tcp_conn->timer_prev = NULL;
+    tcp_conn->timer_next = NULL;
+    tcp_conn->timer_due = 0;
+}
+
+/**
+ * @brief 按连接最早到期的计时器把它挂到计时轮上，计时器改变后调用
+ * 超出一圈的到期时间挂在最远的槽上，届时重新挂入；提前到期的计时器由各计时器函数自行判断
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+static void tcp_timer_arm(tcp_conn_t *tcp_conn) {
+    tcp_timer_unlink(tcp_conn);
+    uint64_t due = tcp_conn_deadline(tcp_conn);
+    if (!due)
+        return;
+    uint64_t tick = due / TCP_TIMER_INTERVAL_MS;
+    if (tick <= tcp_timer_tick)
+        tick = tcp_timer_tick + 1;
+    if (tick >= tcp_timer_tick + TCP_TIMER_WHEEL_SIZE)
+        tick = tcp_timer_tick + TCP_TIMER_WHEEL_SIZE - 1;
+    tcp_conn->timer_slot = tick & (TCP_TIMER_WHEEL_SIZE - 1);
+    tcp_conn->timer_due = due;
+    tcp_conn->timer_next = tcp_timer_wheel[tcp_conn->timer_slot];
+    if (tcp_conn->timer_next)
+        tcp_conn->timer_next->timer_prev = tcp_conn;
+    tcp_timer_wheel[tcp_conn->timer_slot] = tcp_conn;
+}
+
+/**
+ * @brief 从连接池分配一个连接，挂入哈希桶与本地端口的链表
+ *
+ * @param key           连接的键
+ * @return tcp_conn_t*  处于 LISTEN 状态的新连接，连接池已满时为 NULL
+ */
+static tcp_conn_t *tcp_conn_alloc(const tcp_key_t *key) {
+    tcp_conn_t *tcp_conn = tcp_conn_free_list;
+    if (tcp_conn)
+        tcp_conn_free_list = tcp_conn->hash_next;
+    else if (tcp_conn_pool_top < net_config.tcp_max_conn_num)
+        tcp_conn = &tcp_conn_pool[tcp_conn_pool_top++];
+    else
+        return NULL;
+    uint32_t gen = tcp_conn->gen;
+    memset(tcp_conn, 0, sizeof(tcp_conn_t));
+    tcp_rst(tcp_conn);
+    tcp_conn->key = *key;
+    tcp_conn->in_use = 1;
+    tcp_conn->gen = gen ? gen : 1;  // 代数从1开始，保证句柄不为0
+    size_t bucket = tcp_key_hash(key);
+    tcp_conn->hash_next = tcp_conn_hash[bucket];
+    tcp_conn_hash[bucket] = tcp_conn;
+    tcp_conn->port_next = tcp_port_conns[key->host_port];
+    if (tcp_conn->port_next)
+        tcp_conn->port_next->port_prev = tcp_conn;
+    tcp_port_conns[key->host_port] = tcp_conn;
+    return tcp_conn;
+}
+
+/**
+ * @brief 将连接从哈希桶与本地端口的链表中摘下，归还连接池
+ *
+ * @param tcp_conn  要释放的连接
+ */
+static void tcp_conn_free(tcp_conn_t *tcp_conn) {
+    tcp_timer_unlink(tcp_conn);
+    tcp_conn_t **link = &tcp_conn_hash[tcp_key_hash(&tcp_conn->key)];
+    while (*link != tcp_conn)
+        link = &(*link)->hash_next;
+    *link = tcp_conn->hash_next;
+    if (tcp_conn->port_prev)
+        tcp_conn->port_prev->port_next = tcp_conn->port_next;
+    else
+        tcp_port_conns[tcp_conn->key.host_port] = tcp_conn->port_next;
+    if (tcp_conn->port_next)
+        tcp_conn->port_next->port_prev = tcp_conn->port_prev;
+    tcp_conn->in_use = 0;
+    tcp_conn->gen++;
+    tcp_conn->hash_next = tcp_conn_free_list;
+    tcp_conn_free_list = tcp_conn;
+}
+
+/**
+ * @brief 从收发缓冲区池分配一块缓冲区
+ *
+ * @return void*    缓冲区池已满时为 NULL
+ */
+static void *tcp_buf_alloc() {
+    tcp_buf_slot_t *slot = tcp_buf_free_list;
+    if (slot)
+        tcp_buf_free_list = slot->next;
+    else if (tcp_buf_pool_top < net_config.tcp_max_buf_num)
+        slot = &tcp_buf_pool[tcp_buf_pool_top++];
+    return slot;
+}
+
+/**
+ * @brief 将缓冲区归还收发缓冲区池
+ *
+ * @param buf   tcp_buf_alloc() 分配的缓冲区，可以为 NULL
+ */
+static void tcp_buf_free(void *buf) {
+    tcp_buf_slot_t *slot = buf;
+    if (!slot)
+        return;
+    slot->next = tcp_buf_free_list;
+    tcp_buf_free_list = slot;
+}
+
+/**
+ * @brief 根据连接的键查找或创建 TCP 连接
+ *
+ * @param key               连接的键
  * @param create_if_missing 若为 1，则在未找到连接时创建新的 TCP 连接；若为 0，则仅查找
  *
  * @return tcp_conn_t* 指向已存在或新创建的 TCP 连接的指针；若未找到且无需创建，则返回 NULL
  */
-static inline tcp_conn_t *tcp_get_connection(uint8_t remote_ip[NET_IP_LEN], uint16_t remote_port, uint16_t host_port, uint8_t create_if_missing) {
-    tcp_key_t key = generate_tcp_key(remote_ip, remote_port, host_port);
-    tcp_conn_t *tcp_conn = map_get(&tcp_conn_table, &key);
-    if (!tcp_conn && create_if_missing) {
-        tcp_conn_t new_conn;
-        tcp_rst(&new_conn);
-        map_set(&tcp_conn_table, &key, &new_conn);
-        tcp_conn = map_get(&tcp_conn_table, &key);
-    }
+static inline tcp_conn_t *tcp_get_connection(const tcp_key_t *key, uint8_t create_if_missing) {
+    tcp_conn_t *tcp_conn = tcp_conn_lookup(key);
+    if (!tcp_conn && create_if_missing)
+        tcp_conn = tcp_conn_alloc(key);
     return tcp_conn;
 }
 
+/**
+ * @brief 半连接完成握手或被释放，不再计入半连接数
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+static inline void tcp_half_open_done(tcp_conn_t *tcp_conn) {
+    if (tcp_conn->half_open) {
+        tcp_conn->half_open = 0;
+        tcp_half_open_num--;
+        tcp_listener_t *listener = map_get(&tcp_listener_table, &tcp_conn->key.host_port);
+        if (listener && listener->half_open_num)
+            listener->half_open_num--;
+    }
+}
+
+/**
+ * @brief 连接进入 TIME_WAIT 或被释放，不再计入监听者的已建立连接数
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+static inline void tcp_accepted_done(tcp_conn_t *tcp_conn) {
+    if (tcp_conn->accepted) {
+        tcp_conn->accepted = 0;
+        tcp_listener_t *listener = map_get(&tcp_listener_table, &tcp_conn->key.host_port);
+        if (listener && listener->established_num)
+            listener->established_num--;
+    }
+}
+
+/**
+ * @brief 被动打开的连接沿用监听者的接收方式、保活与空闲超时配置
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param listener  连接所属的监听者，可以为 NULL
+ */
+static void tcp_listener_inherit(tcp_conn_t *tcp_conn, tcp_listener_t *listener) {
+    tcp_conn->last_active = clock_ms();
+    if (!listener)
+        return;
+    tcp_conn->readable_handler = listener->opts.readable_handler;
+    tcp_conn->close_handler = listener->opts.close_handler;
+    tcp_conn->idle_timeout = listener->opts.idle_timeout;
+    tcp_conn->keepalive_idle = listener->opts.keepalive_idle;
+    tcp_conn->keepalive_interval = listener->opts.keepalive_interval;
+    tcp_conn->keepalive_probes = listener->opts.keepalive_probes;
+}
+
+/**
+ * @brief 释放一个 TCP 连接及其收发队列
+ *
+ * @param tcp_conn  要释放的连接
+ */
+static void tcp_conn_release(tcp_conn_t *tcp_conn) {
+    tcp_half_open_done(tcp_conn);
+    tcp_accepted_done(tcp_conn);
+    tcp_buf_free(tcp_conn->ooo);
+    tcp_buf_free(tcp_conn->txq);
+    tcp_buf_free(tcp_conn->rxq);
+    tcp_conn->ooo = NULL;
+    tcp_conn->txq = NULL;
+    tcp_conn->rxq = NULL;
+    tcp_conn_free(tcp_conn);
+}
+
 /**
  * @brief 关闭一个 TCP 连接
  *
- * @param remote_ip
- * @param remote_port
- * @param host_port
+ * @param key   连接的键
+ */
+static inline void tcp_close_connection(const tcp_key_t *key) {
+    tcp_conn_t *tcp_conn = tcp_conn_lookup(key);
+    if (tcp_conn)
+        tcp_conn_release(tcp_conn);
+}
+
+/**
+ * @brief 将乱序队列的起点推进到新的 ack，丢弃已交付的数据与区间
+ *
+ * @param ooo   乱序队列
+ * @param ack   新的期望序列号
+ */
+static void tcp_ooo_advance(tcp_ooo_t *ooo, uint32_t ack) {
+    uint32_t shift = ack - ooo->base;
+    if (shift == 0)
+        return;
+
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < ooo->block_num; i++) {
+        tcp_block_t block = ooo->blocks[i];
+        if (TCP_SEQ_LEQ(block.right, ack))
+            continue;
+        if (TCP_SEQ_LT(block.left, ack))
+            block.left = ack;
+        ooo->blocks[n++] = block;
+    }
+    ooo->block_num = n;
+    // 只搬移仍有区间覆盖的部分，区间之外的缓存内容无效
+    if (n)
+        memmove(ooo->data + (ooo->blocks[0].left - ack), ooo->data + (ooo->blocks[0].left - ooo->base), ooo->blocks[n - 1].right - ooo->blocks[0].left);
+    ooo->base = ack;
+}
+
+/**
+ * @brief 将一个乱序到达的报文段放入乱序队列，并合并相交或相邻的区间
+ *
+ * @param ooo   乱序队列，base 必须等于当前连接的 ack
+ * @param seq   报文段数据的起始序列号
+ * @param data  报文段数据
+ * @param len   报文段数据长度
+ * @return int  成功为0，超出缓存或区间数已满为-1
+ */
+static int tcp_ooo_insert(tcp_ooo_t *ooo, uint32_t seq, uint8_t *data, size_t len) {
+    uint32_t offset = seq - ooo->base;
+    if (offset >= TCP_OOO_BUF_LEN)
+        return -1;
+    if (len > TCP_OOO_BUF_LEN - offset)
+        len = TCP_OOO_BUF_LEN - offset;
+    if (len == 0)
+        return 0;
+
+    tcp_block_t merged = {seq, seq + len};
+    tcp_block_t blocks[TCP_OOO_MAX_BLOCKS + 1];
+    uint8_t n = 0, inserted = 0;
+    for (uint8_t i = 0; i < ooo->block_num; i++) {
+        tcp_block_t block = ooo->blocks[i];
+        if (TCP_SEQ_LT(block.right, merged.left)) {
+            blocks[n++] = block;  // 完全位于新区间之前
+        } else if (TCP_SEQ_GT(block.left, merged.right)) {
+            if (!inserted)
+                blocks[n++] = merged, inserted = 1;
+            blocks[n++] = block;  // 完全位于新区间之后
+        } else {
+            // 相交或相邻，合并为一个区间
+            if (TCP_SEQ_LT(block.left, merged.left))
+                merged.left = block.left;
+            if (TCP_SEQ_GT(block.right, merged.right))
+                merged.right = block.right;
+        }
+    }
+    if (!inserted)
+        blocks[n++] = merged;
+    if (n > TCP_OOO_MAX_BLOCKS)
+        return -1;
+
+    memcpy(ooo->data + offset, data, len);
+    memcpy(ooo->blocks, blocks, n * sizeof(tcp_block_t));
+    ooo->block_num = n;
+    ooo->last_seq = seq;
+    return 0;
+}
+
+/**
+ * @brief 解析 TCP 选项
+ *
+ * @param opts      选项起始地址
+ * @param len       选项长度
+ * @param tcp_opts  出口参数，解析结果
+ */
+static void tcp_parse_options(uint8_t *opts, size_t len, tcp_opts_t *tcp_opts) {
+    memset(tcp_opts, 0, sizeof(tcp_opts_t));
+    size_t i = 0;
+    while (i < len) {
+        uint8_t kind = opts[i];
+        if (kind == TCP_OPT_EOL)
+            break;
+        if (kind == TCP_OPT_NOP) {
+            i++;
+            continue;
+        }
+        // 其余选项均为 kind-length-value 格式，长度非法时放弃解析
+        if (i + 1 >= len || opts[i + 1] < 2 || i + opts[i + 1] > len)
+            break;
+        uint8_t opt_len = opts[i + 1];
+        uint8_t *value = opts + i + 2;
+        switch (kind) {
+            case TCP_OPT_MSS:
+                if (opt_len == 4)
+                    tcp_opts->mss = swap16(*(uint16_t *)value);
+                break;
+            case TCP_OPT_WSCALE:
+                if (opt_len == 3) {
+                    tcp_opts->wscale_ok = 1;
+                    tcp_opts->wscale = value[0] > TCP_MAX_WSCALE ? TCP_MAX_WSCALE : value[0];
+                }
+                break;
+            case TCP_OPT_TIMESTAMP:
+                if (opt_len == 10) {
+                    tcp_opts->ts_ok = 1;
+                    tcp_opts->ts_val = swap32(*(uint32_t *)value);
+                    tcp_opts->ts_ecr = swap32(*(uint32_t *)(value + 4));
+                }
+                break;
+            case TCP_OPT_SACK_PERMITTED:
+                tcp_opts->sack_permitted = 1;
+                break;
+            case TCP_OPT_SACK:
+                for (size_t j = 0; j + 8 <= opt_len - 2u && tcp_opts->sack_num < TCP_SACK_MAX_BLOCKS; j += 8) {
+                    tcp_block_t *block = &tcp_opts->sack[tcp_opts->sack_num++];
+                    block->left = swap32(*(uint32_t *)(value + j));
+                    block->right = swap32(*(uint32_t *)(value + j + 4));
+                }
+                break;
+            default:
+                break;
+        }
+        i += opt_len;
+    }
+}
+
+/**
+ * @brief 根据连接状态生成要发送的 TCP 选项
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param flags     报文段的标志位
+ * @param opts      出口参数，生成的选项，长度不超过 TCP_OPT_MAX_LEN
+ * @return size_t   选项长度，总是 4 的倍数
+ */
+static size_t tcp_build_options(tcp_conn_t *tcp_conn, uint8_t flags, uint8_t *opts) {
+    size_t len = 0;
+
+    // SYN 报文段中声明本端 MSS，以及对端已提供的窗口扩大、SACK 与时间戳选项
+    if (TCP_FLG_ISSET(flags, TCP_FLG_SYN)) {
+        opts[len++] = TCP_OPT_MSS;
+        opts[len++] = 4;
+        *(uint16_t *)(opts + len) = swap16(tcp_path_mss(tcp_conn));
+        len += 2;
+        if (tcp_conn->wscale_ok) {
+            opts[len++] = TCP_OPT_NOP;
+            opts[len++] = TCP_OPT_WSCALE;
+            opts[len++] = 3;
+            opts[len++] = tcp_conn->rcv_wscale;
+        }
+        if (tcp_conn->sack_permitted) {
+            opts[len++] = TCP_OPT_NOP;
+            opts[len++] = TCP_OPT_NOP;
+            opts[len++] = TCP_OPT_SACK_PERMITTED;
+            opts[len++] = 2;
+        }
+    }
+
+    // 协商启用时间戳后，每个报文段都携带时间戳
+    if (tcp_conn->ts_ok) {
+        opts[len++] = TCP_OPT_NOP;
+        opts[len++] = TCP_OPT_NOP;
+        opts[len++] = TCP_OPT_TIMESTAMP;
+        opts[len++] = 10;
+        *(uint32_t *)(opts + len) = swap32(tcp_ts_now());
+        *(uint32_t *)(opts + len + 4) = swap32(tcp_conn->ts_recent);
+        len += 8;
+    }
+    if (TCP_FLG_ISSET(flags, TCP_FLG_SYN) || !tcp_conn->sack_permitted)
+        return len;
+
+    // 存在乱序数据时携带 SACK 区间，包含最近到达报文段的区间排在最前
+    tcp_ooo_t *ooo = tcp_conn->ooo;
+    if (!TCP_FLG_ISSET(flags, TCP_FLG_ACK) || !ooo || ooo->block_num == 0)
+        return len;
+    tcp_block_t blocks[TCP_OOO_MAX_BLOCKS];
+    uint8_t n = 0, max_n = (TCP_OPT_MAX_LEN - len - 4) / 8;
+    for (uint8_t i = 0; i < ooo->block_num; i++) {
+        tcp_block_t block = ooo->blocks[i];
+        // 交付过程中乱序队列尚未推进，跳过已被累计确认的区间
+        if (TCP_SEQ_LEQ(block.right, tcp_conn->ack))
+            continue;
+        if (TCP_SEQ_LEQ(block.left, ooo->last_seq) && TCP_SEQ_LT(ooo->last_seq, block.right)) {
+            memmove(blocks + 1, blocks, n * sizeof(tcp_block_t));
+            blocks[0] = block;
+        } else {
+            blocks[n] = block;
+        }
+        n++;
+    }
+    if (n > max_n)
+        n = max_n;  // 选项空间不足时只携带最前面的区间
+    if (n == 0)
+        return len;
+    opts[len++] = TCP_OPT_NOP;
+    opts[len++] = TCP_OPT_NOP;
+    opts[len++] = TCP_OPT_SACK;
+    opts[len++] = 2 + 8 * n;
+    for (uint8_t i = 0; i < n; i++) {
+        *(uint32_t *)(opts + len) = swap32(blocks[i].left);
+        *(uint32_t *)(opts + len + 4) = swap32(blocks[i].right);
+        len += 8;
+    }
+    return len;
+}
+
+/**
+ * @brief 接收顺序数据并推进 ack：使用接收缓冲区的连接只接收剩余空间能容纳的部分并通知应用程序可读，
+ * 否则直接交付给连接或端口对应的处理程序
+ *
+ * @param tcp_conn      当前 TCP 连接
+ * @param data          数据
+ * @param len           数据长度
+ * @param remote_ip     对端 IP 地址
+ * @param remote_port   对端端口号
+ * @param host_port     本地端口号
+ * @return size_t       接收的字节数，小于 len 时其余部分被丢弃，由对端在窗口打开后重传
+ */
+static size_t tcp_deliver(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *remote_ip, uint16_t remote_port, uint16_t host_port) {
+    if (len == 0)
+        return 0;
+    tcp_conn->last_active = clock_ms();
+    if (tcp_conn->readable_handler) {
+        tcp_rxq_t *rxq = tcp_conn->rxq;
+        if (!rxq) {
+            if (!(rxq = tcp_buf_alloc()))
+                return 0;
+            rxq->len = 0;
+            tcp_conn->rxq = rxq;
+        }
+        if (len > TCP_RXQ_BUF_LEN - rxq->len)
+            len = TCP_RXQ_BUF_LEN - rxq->len;
+        memcpy(rxq->data + rxq->len, data, len);
+        rxq->len += len;
+        tcp_conn->ack += len;
+        if (len) {
+            tcp_reading_conn = tcp_conn;
+            tcp_conn->readable_handler(tcp_conn, rxq->len, remote_ip, remote_port);
+            tcp_reading_conn = NULL;
+        }
+        // 应用程序读完了全部数据，释放接收缓冲区
+        if (tcp_conn->rxq && tcp_conn->rxq->len == 0) {
+            tcp_buf_free(tcp_conn->rxq);
+            tcp_conn->rxq = NULL;
+        }
+        return len;
+    }
+    tcp_conn->ack += len;
+    tcp_handler_t handler = tcp_conn->handler;
+    if (!handler) {
+        tcp_listener_t *listener = map_get(&tcp_listener_table, &host_port);
+        handler = listener ? listener->handler : NULL;
+    }
+    if (handler)
+        handler(tcp_conn, data, len, remote_ip, remote_port);
+    return len;
+}
+
+/**
+ * @brief 将应用程序要发送的数据追加到连接的发送队列，由 tcp_output() 决定何时发出
+ * 队列剩余空间不足时只追加能放下的部分
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param data      数据，为 NULL 时填充 0
+ * @param len       数据长度
+ * @return int      追加的字节数，发送队列不可用或已排入 FIN 时为-1
+ */
+static int tcp_txq_push(tcp_conn_t *tcp_conn, uint8_t *data, size_t len) {
+    tcp_txq_t *txq = tcp_conn->txq;
+    if (!txq) {
+        if (!(txq = tcp_buf_alloc()))
+            return -1;
+        txq->base = tcp_conn->seq;
+        txq->len = 0;
+        txq->rto_time = clock_ms();
+        txq->backoff = 0;
+        txq->retries = 0;
+        txq->fin = 0;
+        txq->rexmit_next = tcp_conn->seq;
+        txq->sacked_num = 0;
+        tcp_conn->txq = txq;
+    }
+    if (txq->fin)
+        return -1;
+    if (len > TCP_TXQ_BUF_LEN - txq->len)
+        len = TCP_TXQ_BUF_LEN - txq->len;
+    if (data)
+        memcpy(txq->data + txq->len, data, len);
+    else
+        memset(txq->data + txq->len, 0, len);
+    txq->len += len;
+    return len;
+}
+
+/**
+ * @brief 从重传队列中移除已被累计确认的数据
+ *
+ * @param txq   重传队列
+ * @param una   新的最早未确认序列号
+ */
+static void tcp_txq_ack(tcp_txq_t *txq, uint32_t una) {
+    if (TCP_SEQ_LEQ(una, txq->base))
+        return;
+    if (txq->fin && TCP_SEQ_GT(una, txq->base + txq->len))
+        txq->fin = 0;  // FIN 已被确认
+    uint32_t acked = una - txq->base;
+    if (acked > txq->len)
+        acked = txq->len;
+    memmove(txq->data, txq->data + acked, txq->len - acked);
+    txq->len -= acked;
+    txq->base = una;
+
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < txq->sacked_num; i++) {
+        tcp_block_t block = txq->sacked[i];
+        if (TCP_SEQ_LEQ(block.right, una))
+            continue;
+        if (TCP_SEQ_LT(block.left, una))
+            block.left = una;
+        txq->sacked[n++] = block;
+    }
+    txq->sacked_num = n;
+}
+
+/**
+ * @brief 将对端通告的 SACK 区间合并到重传队列的记分板中
+ *
+ * @param txq       重传队列
+ * @param tcp_opts  收到的报文段的选项
+ * @param end       已发送数据的末尾序列号
+ */
+static void tcp_txq_sack(tcp_txq_t *txq, tcp_opts_t *tcp_opts, uint32_t end) {
+    for (uint8_t i = 0; i < tcp_opts->sack_num; i++) {
+        tcp_block_t merged = tcp_opts->sack[i];
+        // 忽略不合法或已被累计确认的区间
+        if (TCP_SEQ_GEQ(merged.left, merged.right) || TCP_SEQ_LEQ(merged.right, txq->base) || TCP_SEQ_GT(merged.right, end))
+            continue;
+        if (TCP_SEQ_LT(merged.left, txq->base))
+            merged.left = txq->base;
+
+        tcp_block_t blocks[TCP_SACK_MAX_BLOCKS + 1];
+        uint8_t n = 0, inserted = 0;
+        for (uint8_t j = 0; j < txq->sacked_num; j++) {
+            tcp_block_t block = txq->sacked[j];
+            if (TCP_SEQ_LT(block.right, merged.left)) {
+                blocks[n++] = block;
+            } else if (TCP_SEQ_GT(block.left, merged.right)) {
+                if (!inserted)
+                    blocks[n++] = merged, inserted = 1;
+                blocks[n++] = block;
+            } else {
+                if (TCP_SEQ_LT(block.left, merged.left))
+                    merged.left = block.left;
+                if (TCP_SEQ_GT(block.right, merged.right))
+                    merged.right = block.right;
+            }
+        }
+        if (!inserted)
+            blocks[n++] = merged;
+        // 记分板已满时舍弃序列号最高的区间，靠近 una 的空洞更需要修复
+        if (n > TCP_SACK_MAX_BLOCKS)
+            n = TCP_SACK_MAX_BLOCKS;
+        memcpy(txq->sacked, blocks, n * sizeof(tcp_block_t));
+        txq->sacked_num = n;
+    }
+}
+
+/**
+ * @brief 已发出的、可以重传的序列空间的末尾，不超过发送队列中的数据与 FIN
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param txq       发送队列
+ * @return uint32_t 末尾序列号
+ */
+static inline uint32_t tcp_txq_sent_end(tcp_conn_t *tcp_conn, tcp_txq_t *txq) {
+    uint32_t end = txq->base + txq->len + txq->fin;
+    return TCP_SEQ_LT(tcp_conn->seq, end) ? tcp_conn->seq : end;
+}
+
+/**
+ * @brief 发送发送队列中的一段数据，用于首次发送与重传，覆盖到队尾的 FIN 时一并携带
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ * @param txq       发送队列
+ * @param seq       起始序列号
+ * @param len       序列空间长度，可以包含 FIN
+ */
+static void tcp_txq_send(tcp_conn_t *tcp_conn, tcp_key_t *key, tcp_txq_t *txq, uint32_t seq, size_t len) {
+    uint8_t flags = TCP_FLG_ACK;
+    uint32_t data_end = txq->base + txq->len;
+    assert(seq - txq->base <= txq->len && seq - txq->base + len <= txq->len + txq->fin);
+    if (txq->fin && TCP_SEQ_GT(seq + len, data_end)) {
+        flags |= TCP_FLG_FIN;
+        len = data_end - seq;
+    }
+    buf_t tx_buf;
+    buf_init(&tx_buf, len);
+    memcpy(tx_buf.data, txq->data + (seq - txq->base), len);
+    tcp_out_seq(tcp_conn, &tx_buf, seq, key->host_port, key->remote_ip, key->remote_port, flags);
+}
+
+/**
+ * @brief 快速恢复阶段的重传：启用 SACK 时重传记分板中的下一个空洞，否则重传最早未确认的报文段
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ * @param txq       重传队列
+ */
+static void tcp_recovery_retransmit(tcp_conn_t *tcp_conn, tcp_key_t *key, tcp_txq_t *txq) {
+    uint32_t start = txq->base;
+    uint32_t end = tcp_txq_sent_end(tcp_conn, txq);
+    if (tcp_conn->sack_permitted && txq->sacked_num) {
+        if (TCP_SEQ_GT(txq->rexmit_next, start))
+            start = txq->rexmit_next;
+        // 空洞只存在于最高的 SACK 区间之下
+        uint32_t sent_end = end;
+        end = start;
+        for (uint8_t i = 0; i < txq->sacked_num; i++) {
+            tcp_block_t block = txq->sacked[i];
+            if (TCP_SEQ_LT(start, block.left)) {
+                end = TCP_SEQ_LT(block.left, sent_end) ? block.left : sent_end;
+                break;
+            }
+            if (TCP_SEQ_LT(start, block.right))
+                start = block.right;
+        }
+        if (end == start || TCP_SEQ_LT(end, start))
+            return;
+    }
+    size_t len = end - start;
+    if (len > tcp_send_mss(tcp_conn))
+        len = tcp_send_mss(tcp_conn);
+    if (len == 0)
+        return;
+    tcp_txq_send(tcp_conn, key, txq, start, len);
+    txq->rexmit_next = start + len;
+    txq->rto_time = clock_ms();
+}
+
+/**
+ * @brief 发出发送队列中尚未发送、且落在对端通告窗口内的数据
+ * 满 MSS 的报文段总是立即发送；不足 MSS 的尾部数据按 Nagle 算法仅在没有未确认数据时发送，
+ * 连接被 cork 时则一直暂缓，直到凑满 MSS 或调用 tcp_flush()。排队的 FIN 随最后一段数据发出。
+ * 窗口关闭且没有在途数据时启动坚持计时器，由它发送零窗口探测
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ * @param force     为 1 时忽略 Nagle 算法与 cork，发出全部数据
+ */
+static void tcp_output(tcp_conn_t *tcp_conn, tcp_key_t *key, uint8_t force) {
+    tcp_txq_t *txq = tcp_conn->txq;
+    if (!txq)
+        return;
+    size_t mss = tcp_send_mss(tcp_conn);
+    uint32_t end = txq->base + txq->len + txq->fin;
+    uint32_t wnd_end = tcp_conn->una + tcp_conn->snd_wnd;
+    if (TCP_SEQ_LEQ(wnd_end, tcp_conn->seq) && TCP_SEQ_LT(tcp_conn->seq, end)) {
+        if (tcp_conn->una == tcp_conn->seq && !tcp_conn->persist_due) {
+            tcp_conn->persist_due = clock_ms() + tcp_conn->rto;
+            tcp_timer_arm(tcp_conn);
+        }
+        return;
+    }
+    tcp_conn->persist_due = 0;
+    if (TCP_SEQ_LT(wnd_end, end))
+        end = wnd_end;
+    while (TCP_SEQ_LT(tcp_conn->seq, end)) {
+        size_t len = end - tcp_conn->seq;
+        if (len > mss)
+            len = mss;
+        if (len < mss && !force && (tcp_conn->corked || (!tcp_conn->nodelay && tcp_conn->una != tcp_conn->seq)))
+            break;
+        // 没有在途数据时启动重传计时器
+        uint8_t idle = tcp_conn->una == tcp_conn->seq;
+        if (idle)
+            txq->rto_time = clock_ms();
+        tcp_txq_send(tcp_conn, key, txq, tcp_conn->seq, len);
+        tcp_conn->seq += len;
+        if (idle)
+            tcp_timer_arm(tcp_conn);
+    }
+}
+
+/**
+ * @brief 处理收到的报文段中的确认信息，更新重传队列并在需要时进行快速重传
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ * @param ack       报文段的确认号
+ * @param tcp_opts  报文段的选项
+ * @param wnd       报文段通告的窗口（已按窗口扩大因子换算）
+ * @param maybe_dup 报文段不携带数据且未改变窗口，可以作为重复 ACK 计数
+ */
+static void tcp_ack_in(tcp_conn_t *tcp_conn, tcp_key_t *key, uint32_t ack, tcp_opts_t *tcp_opts, uint32_t wnd, uint8_t maybe_dup) {
+    // 确认了尚未发送的数据，忽略确认信息
+    if (TCP_SEQ_GT(ack, tcp_conn->seq) || TCP_SEQ_LT(ack, tcp_conn->una))
+        return;
+    uint32_t old_wnd = tcp_conn->snd_wnd;
+    tcp_conn->snd_wnd = wnd;
+
+    tcp_txq_t *txq = tcp_conn->txq;
+    // 对端通告零窗口说明其仍然存活，坚持探测的重传不计入重传次数
+    if (txq && wnd == 0)
+        txq->retries = 0;
+    if (txq && tcp_conn->sack_permitted)
+        tcp_txq_sack(txq, tcp_opts, tcp_conn->seq);
+
+    // 确认了新数据
+    if (TCP_SEQ_GT(ack, tcp_conn->una)) {
+        tcp_conn->una = ack;
+        tcp_conn->dup_acks = 0;
+        // 回显的时间戳给出了一个 RTT 样本，重传的报文段同样适用
+        if (tcp_conn->ts_ok && tcp_opts->ts_ok && tcp_opts->ts_ecr)
+            tcp_rtt_update(tcp_conn, tcp_ts_now() - tcp_opts->ts_ecr);
+        if (!txq)
+            return;
+        tcp_txq_ack(txq, ack);
+        txq->rto_time = clock_ms();
+        txq->backoff = 0;
+        txq->retries = 0;
+        if (tcp_conn->in_recovery) {
+            if (TCP_SEQ_GEQ(ack, tcp_conn->recover))
+                tcp_conn->in_recovery = 0;
+            else
+                tcp_recovery_retransmit(tcp_conn, key, txq);  // 部分确认，继续修复下一个空洞
+        }
+        if (txq->len == 0 && !txq->fin) {
+            tcp_buf_free(txq);
+            tcp_conn->txq = NULL;
+        } else
+            tcp_output(tcp_conn, key, 0);  // 确认到达后放行被 Nagle 算法暂缓的数据
+        return;
+    }
+
+    // 窗口更新：放行因窗口关闭而暂缓的数据
+    if (wnd > old_wnd && txq) {
+        tcp_output(tcp_conn, key, 0);
+        return;
+    }
+
+    // 重复 ACK：没有未确认的数据时不计数
+    if (!maybe_dup || tcp_conn->una == tcp_conn->seq)
+        return;
+    if (tcp_conn->dup_acks < UINT8_MAX)
+        tcp_conn->dup_acks++;
+    if (!txq)
+        return;
+    if (!tcp_conn->in_recovery && tcp_conn->dup_acks >= TCP_DUP_ACK_THRESHOLD) {
+        tcp_conn->in_recovery = 1;
+        tcp_conn->recover = tcp_conn->seq;
+        txq->rexmit_next = txq->base;
+        tcp_recovery_retransmit(tcp_conn, key, txq);
+    } else if (tcp_conn->in_recovery && tcp_conn->sack_permitted) {
+        tcp_recovery_retransmit(tcp_conn, key, txq);
+    }
+}
+
+/**
+ * @brief 根据对端 SYN 报文段中的选项确定连接启用的选项
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param tcp_opts  对端 SYN 报文段的选项
+ */
+static void tcp_negotiate_options(tcp_conn_t *tcp_conn, tcp_opts_t *tcp_opts) {
+    if (tcp_opts->mss)
+        tcp_conn->mss = tcp_opts->mss;
+    tcp_conn->wscale_ok = tcp_opts->wscale_ok;
+    tcp_conn->snd_wscale = tcp_opts->wscale_ok ? tcp_opts->wscale : 0;
+    tcp_conn->rcv_wscale = tcp_opts->wscale_ok ? TCP_WINDOW_SCALE : 0;
+    tcp_conn->ts_ok = tcp_opts->ts_ok;
+    tcp_conn->ts_recent = tcp_opts->ts_val;
+    tcp_conn->sack_permitted = tcp_opts->sack_permitted;
+}
+
+/**
+ * @brief 发送（或重传）握手报文：主动打开时为 SYN，被动打开时为 SYN-ACK
+ *
+ * @param tcp_conn  当前 TCP 连接，una 为初始序列号
+ * @param key       当前连接的键
+ */
+static void tcp_send_syn(tcp_conn_t *tcp_conn, tcp_key_t *key) {
+    uint8_t flags = tcp_conn->state == TCP_STATE_SYN_RECEIVED ? TCP_FLG_SYN | TCP_FLG_ACK : TCP_FLG_SYN;
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    tcp_out_seq(tcp_conn, &tx_buf, tcp_conn->una, key->host_port, key->remote_ip, key->remote_port, flags);
+}
+
+/**
+ * @brief 不依赖连接状态回复 RST（RFC 793 Reset Generation）
+ *
+ * @param key       报文段所属四元组的键
+ * @param hdr       收到的报文段的首部
+ * @param seg_len   收到的报文段占用的序列空间长度
+ */
+static void tcp_send_reset(tcp_key_t *key, tcp_hdr_t *hdr, size_t seg_len) {
+    // 令牌桶限速：每秒补充 TCP_RST_RATE 个，最多积攒 TCP_RST_BURST 个，防止被用于反射放大
+    static uint64_t last_refill;
+    static uint32_t tokens;
+    uint64_t now = clock_ms();
+    uint64_t refill = (now - last_refill) * TCP_RST_RATE / 1000;
+    if (refill) {
+        tokens = tokens + refill > TCP_RST_BURST ? TCP_RST_BURST : tokens + refill;
+        last_refill = now;
+    }
+    if (tokens == 0)
+        return;
+    tokens--;
+
+    tcp_conn_t tmp_conn;
+    tcp_rst(&tmp_conn);
+    tmp_conn.key = *key;
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    if (TCP_FLG_ISSET(hdr->flags, TCP_FLG_ACK)) {
+        tcp_out_seq(&tmp_conn, &tx_buf, swap32(hdr->ack), key->host_port, key->remote_ip, key->remote_port, TCP_FLG_RST);
+    } else {
+        tmp_conn.ack = swap32(hdr->seq) + seg_len;
+        tcp_out_seq(&tmp_conn, &tx_buf, 0, key->host_port, key->remote_ip, key->remote_port, TCP_FLG_RST | TCP_FLG_ACK);
+    }
+}
+
+/**
+ * @brief 计算 SYN cookie 的校验部分
+ *
+ * @param key       连接的键
+ * @param peer_isn  对端的初始序列号
+ * @param count     cookie 计数器
+ * @return uint32_t 校验值
+ */
+static uint32_t tcp_cookie_hash(tcp_key_t *key, uint32_t peer_isn, uint32_t count) {
+    const uint32_t *local = (const uint32_t *)key->local_ip, *remote = (const uint32_t *)key->remote_ip;
+    uint32_t words[] = {TCP_HASH_COOKIE, count, local[0], local[1], local[2], local[3], remote[0], remote[1], remote[2], remote[3], ((uint32_t)key->remote_port << 16) | key->host_port, peer_isn};
+    return (uint32_t)siphash24(tcp_secret, words, sizeof(words));
+}
+
+/**
+ * @brief 生成 SYN cookie 作为本端的初始序列号
+ * 高5位为计数器，随后3位为 MSS 编号，低24位为校验值
+ *
+ * @param key       连接的键
+ * @param peer_isn  对端的初始序列号
+ * @param mss       对端声明的 MSS
+ * @return uint32_t SYN cookie
+ */
+static uint32_t tcp_cookie_make(tcp_key_t *key, uint32_t peer_isn, uint16_t mss) {
+    uint32_t count = clock_ms() / 1000 / TCP_SYN_COOKIE_PERIOD;
+    uint32_t mss_idx = 0;
+    for (uint32_t i = 0; i < sizeof(tcp_cookie_mss_table) / sizeof(tcp_cookie_mss_table[0]); i++)
+        if (tcp_cookie_mss_table[i] <= mss)
+            mss_idx = i;
+    return (count & 0x1f) << 27 | mss_idx << 24 | (tcp_cookie_hash(key, peer_isn, count) & 0xffffff);
+}
+
+/**
+ * @brief 校验 SYN cookie
+ *
+ * @param key       连接的键
+ * @param peer_isn  对端的初始序列号
+ * @param cookie    待校验的 cookie
+ * @return int      有效时返回 cookie 中编码的 MSS，无效为-1
+ */
+static int tcp_cookie_check(tcp_key_t *key, uint32_t peer_isn, uint32_t cookie) {
+    uint32_t now = clock_ms() / 1000 / TCP_SYN_COOKIE_PERIOD;
+    uint32_t age = (now - (cookie >> 27)) & 0x1f;
+    uint32_t mss_idx = (cookie >> 24) & 0x7;
+    if (age > 1 || mss_idx >= sizeof(tcp_cookie_mss_table) / sizeof(tcp_cookie_mss_table[0]))
+        return -1;
+    if ((tcp_cookie_hash(key, peer_isn, now - age) & 0xffffff) != (cookie & 0xffffff))
+        return -1;
+    return tcp_cookie_mss_table[mss_idx];
+}
+
+/**
+ * @brief 不分配连接，以 SYN cookie 作为初始序列号回复 SYN-ACK
+ * 连接状态全部编码在 cookie 中，因此只能保留 MSS，不启用其他选项
+ *
+ * @param key       连接的键
+ * @param peer_isn  对端的初始序列号
+ * @param tcp_opts  对端 SYN 报文段的选项
+ */
+static void tcp_cookie_send_synack(tcp_key_t *key, uint32_t peer_isn, tcp_opts_t *tcp_opts) {
+    tcp_conn_t tmp_conn;
+    tcp_rst(&tmp_conn);
+    tmp_conn.key = *key;
+    tmp_conn.ack = peer_isn + 1;
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    uint32_t cookie = tcp_cookie_make(key, peer_isn, tcp_opts->mss ? tcp_opts->mss : TCP_PEER_DEFAULT_MSS);
+    tcp_out_seq(&tmp_conn, &tx_buf, cookie, key->host_port, key->remote_ip, key->remote_port, TCP_FLG_SYN | TCP_FLG_ACK);
+}
+
+/**
+ * @brief 对端确认了 SYN cookie 时，根据 cookie 重建连接
+ *
+ * @param key           连接的键
+ * @param remote_seq    报文段的序列号
+ * @param ack           报文段的确认号
+ * @param remote_win    对端通告的窗口
+ * @return tcp_conn_t*  重建的处于 SYN_RECEIVED 状态的连接，cookie 无效或无法分配时为 NULL
+ */
+static tcp_conn_t *tcp_cookie_accept(tcp_key_t *key, uint32_t remote_seq, uint32_t ack, uint16_t remote_win) {
+    int mss = tcp_cookie_check(key, remote_seq - 1, ack - 1);
+    if (mss < 0)
+        return NULL;
+    tcp_conn_t *tcp_conn = tcp_get_connection(key, true);
+    if (!tcp_conn)
+        return NULL;
+    tcp_conn->state = TCP_STATE_SYN_RECEIVED;
+    tcp_conn->passive = 1;
+    tcp_listener_inherit(tcp_conn, map_get(&tcp_listener_table, &key->host_port));
+    tcp_conn->una = ack - 1;
+    tcp_conn->seq = ack;
+    tcp_conn->ack = remote_seq;
+    tcp_conn->ack_sent = remote_seq;
+    tcp_conn->mss = mss;
+    tcp_conn->snd_wnd = remote_win;
+    return tcp_conn;
+}
+
+/**
+ * @brief 通知应用程序主动打开的结果，回调只触发一次
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ * @param status    0表示连接建立，-1表示被拒绝或超时
+ */
+static void tcp_connect_done(tcp_conn_t *tcp_conn, tcp_key_t *key, int status) {
+    tcp_connect_handler_t handler = tcp_conn->connect_handler;
+    tcp_conn->connect_handler = NULL;
+    if (handler)
+        handler(tcp_conn, key->remote_ip, key->remote_port, status);
+}
+
+/**
+ * @brief 通知应用程序连接已关闭，连接被复位或超时的通知只触发一次
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param status    0表示对端已关闭，-1表示连接被复位或超时
+ */
+static void tcp_close_done(tcp_conn_t *tcp_conn, int status) {
+    tcp_close_handler_t handler = tcp_conn->close_handler;
+    if (status < 0)
+        tcp_conn->close_handler = NULL;
+    if (handler)
+        handler(tcp_conn, tcp_conn->key.remote_ip, tcp_conn->key.remote_port, status);
+}
+
+/**
+ * @brief 被动打开的连接完成握手：计入监听者的已建立连接数并通知应用程序
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ */
+static void tcp_listener_established(tcp_conn_t *tcp_conn, tcp_key_t *key) {
+    tcp_listener_t *listener = map_get(&tcp_listener_table, &key->host_port);
+    if (!tcp_conn->passive || !listener)
+        return;
+    tcp_conn->accepted = 1;
+    listener->established_num++;
+    if (listener->opts.established_handler)
+        listener->opts.established_handler(tcp_conn, key->remote_ip, key->remote_port);
+}
+
+/**
+ * @brief 进入 TIME_WAIT 状态并启动 2MSL 计时器，释放连接的收发队列
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param key       当前连接的键
+ */
+static void tcp_time_wait(tcp_conn_t *tcp_conn, tcp_key_t *key) {
+    tcp_accepted_done(tcp_conn);
+    tcp_conn->state = TCP_STATE_TIME_WAIT;
+    tcp_conn->time_wait_due = clock_ms() + net_config.tcp_time_wait_ms;
+    tcp_buf_free(tcp_conn->ooo);
+    tcp_buf_free(tcp_conn->txq);
+    tcp_conn->ooo = NULL;
+    tcp_conn->txq = NULL;
+    tcp_timer_arm(tcp_conn);
+}
+
+/**
+ * @brief 向对端发送 RST，通知应用程序后立即释放连接，用于保活失败、空闲超时与重传超时
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+static void tcp_conn_abort(tcp_conn_t *tcp_conn) {
+    tcp_close_done(tcp_conn, -1);
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    tcp_out(tcp_conn, &tx_buf, tcp_conn->key.host_port, tcp_conn->key.remote_ip, tcp_conn->key.remote_port, TCP_FLG_RST | TCP_FLG_ACK);
+    tcp_conn_release(tcp_conn);
+}
+
+/* =============================== TOOLS =============================== */
+
+/* =============================== COMMON API =============================== */
+
+/**
+ * @brief 以指定的序列号填写 TCP 报文头并发送，用于首次发送与重传
+ *
+ * @param tcp_conn  指向当前 TCP 连接的指针，用于获取确认号、选项等状态信息
+ * @param buf       数据缓冲区，payload 为要发送的数据
+ * @param seq       报文段的序列号
+ * @param src_port  源端口号
+ * @param dst_ip    目标IP地址
+ * @param dst_port  目标端口号
+ * @param flags     TCP 标志位
  */
-static inline void tcp_close_connection(uint8_t remote_ip[NET_IP_LEN], uint16_t remote_port, uint16_t host_port) {
-    tcp_key_t key = generate_tcp_key(remote_ip, remote_port, host_port);
-    map_delete(&tcp_conn_table, &key);
+static void tcp_out_seq(tcp_conn_t *tcp_conn, buf_t *buf, uint32_t seq, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, uint8_t flags) {
+    // Step1: 生成选项，添加 TCP 报头
+    uint8_t opts[TCP_OPT_MAX_LEN];
+    size_t opts_len = tcp_build_options(tcp_conn, flags, opts);
+    buf_add_header(buf, sizeof( tcp_hdr_t ) + opts_len);
+    // Step2: 拷贝首部模板，填充随报文段变化的字段
+    if (!tcp_conn->pseudo_sum) {
+        memset(&tcp_conn->hdr_tmpl, 0, sizeof(tcp_hdr_t));
+        tcp_conn->hdr_tmpl.src_port16 = swap16( src_port );
+        tcp_conn->hdr_tmpl.dst_port16 = swap16( dst_port );
+        if (tcp_conn->key.v6) {
+            peso6_hdr_t pseudo = {.next_header = NET_PROTOCOL_TCP};
+            memcpy(pseudo.src_ip, tcp_conn->key.local_ip, NET_IP6_LEN);
+            memcpy(pseudo.dst_ip, dst_ip, NET_IP6_LEN);
+            tcp_conn->pseudo_sum = checksum_partial(0, &pseudo, sizeof(pseudo));
+        } else {
+            peso_hdr_t pseudo = {.protocol = NET_PROTOCOL_TCP};
+            memcpy(pseudo.src_ip, tcp_conn->key.local_ip, NET_IP_LEN);
+            memcpy(pseudo.dst_ip, dst_ip, NET_IP_LEN);
+            tcp_conn->pseudo_sum = checksum_partial(0, &pseudo, sizeof(pseudo));
+        }
+    }
+    tcp_hdr_t *tcp_hdr = (tcp_hdr_t *)buf->data;
+    *tcp_hdr = tcp_conn->hdr_tmpl;
+    tcp_hdr->seq = swap32( seq );
+    tcp_hdr->ack = swap32( tcp_conn->ack );
+    if (TCP_FLG_ISSET(flags, TCP_FLG_ACK)) {
+        // 任何携带 ACK 的报文段都确认了此前收到的数据，取消延迟确认
+        tcp_conn->ack_sent = tcp_conn->ack;
+        tcp_conn->ack_pending = 0;
+    }
+    tcp_hdr->flags = flags;
+    // SYN 报文段中的窗口不进行缩放
+    uint32_t win = tcp_rcv_window(tcp_conn);
+    uint8_t wscale = TCP_FLG_ISSET(flags, TCP_FLG_SYN) ? 0 : tcp_conn->rcv_wscale;
+    win >>= wscale;
+    if (win > TCP_MAX_WINDOW_SIZE)
+        win = TCP_MAX_WINDOW_SIZE;
+    tcp_hdr->win = swap16( win );
+    tcp_conn->rcv_adv = tcp_conn->ack + (win << wscale);
+    tcp_hdr->doff = ((sizeof( tcp_hdr_t ) + opts_len) / 4) << 4; // 首部长度
+    memcpy(buf->data + sizeof(tcp_hdr_t), opts, opts_len);
+    // Step3： 在伪首部的部分校验和上累加长度与报文段，填充校验和
+    uint32_t sum = tcp_conn->pseudo_sum + swap16(buf->len);
+    tcp_hdr->checksum16 = checksum_finish(checksum_partial(sum, buf->data, buf->len));
+    // Step4： 以连接的首部模板发送 TCP 数据报，ipv6 连接不使用模板
+#ifdef IPV6
+    if (tcp_conn->key.v6) {
+        ip6_out(buf, tcp_conn->key.local_ip, dst_ip, NET_PROTOCOL_TCP);
+        return;
+    }
+#endif
+    ip_out_tmpl(&tcp_conn->ip_tmpl, buf, tcp_conn->key.local_ip, dst_ip, NET_PROTOCOL_TCP);
 }
 
-/* =============================== TOOLS =============================== */
-
-/* =============================== COMMON API =============================== */
-
 /**
  * @brief 填写 TCP 报文头并发送
  *
@@ -116,32 +1338,18 @@ static inline void tcp_close_connection(uint8_t remote_ip[NET_IP_LEN], uint16_t
  * @param flags     TCP 标志位
  */
 void tcp_out(tcp_conn_t *tcp_conn, buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, uint8_t flags) {
-    // Step1: 添加 TCP 报头
-    buf_add_header(buf, sizeof( tcp_hdr_t ));
-    // Step2: 填充 TCP 首部字段
-    tcp_hdr_t *tcp_hdr = (tcp_hdr_t *)buf->data;
-    tcp_hdr->src_port16 = swap16( src_port );
-    tcp_hdr->dst_port16 = swap16( dst_port );
-    tcp_hdr->seq = swap32( tcp_conn->seq );
-    tcp_hdr->ack = swap32( tcp_conn->ack );
-    tcp_hdr->uptr = 0;
-    tcp_hdr->flags = flags;
-    tcp_hdr->win = swap16( TCP_MAX_WINDOW_SIZE );
-    tcp_hdr->doff = (sizeof( tcp_hdr_t ) / 4) << 4; // 首部长度
-    // Step3： 计算并填充校验和
-    tcp_hdr->checksum16 = 0;
-    tcp_hdr->checksum16 = transport_checksum(NET_PROTOCOL_TCP, buf, dst_ip, net_if_ip);
-    // Step4： 发送 TCP 数据报
-    ip_out(buf, dst_ip, NET_PROTOCOL_TCP);
+    tcp_out_seq(tcp_conn, buf, tcp_conn->seq, src_port, dst_ip, dst_port, flags);
 }
 
 /**
- * @brief 处理一个收到的 TCP 数据包
+ * @brief 处理一个收到的 TCP 数据包，ipv4 与 ipv6 共用同一端口上的监听者
  *
  * @param buf       要处理的包
  * @param src_ip    源 IP 地址
+ * @param dst_ip    目的 IP 地址，已确认为本机地址
+ * @param v6        是否为 ipv6 报文段
  */
-void tcp_in(buf_t *buf, uint8_t *src_ip) {
+static void tcp_in_family(buf_t *buf, uint8_t *src_ip, uint8_t *dst_ip, uint8_t v6) {
     // 包检查：判断接收到的数据包长度是否小于 TCP 头部的长度
     // 如果小于，则说明数据包不完整，直接返回，不进行后续处理
     if (buf->len < sizeof(tcp_hdr_t))
@@ -152,27 +1360,119 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
     // 校验checksum
     uint16_t checksum = hdr->checksum16;
     hdr->checksum16 = 0;
-    if (transport_checksum(NET_PROTOCOL_TCP, buf, src_ip, net_if_ip) != checksum)
+    uint16_t calc_checksum = v6 ? transport_checksum6(NET_PROTOCOL_TCP, buf, src_ip, dst_ip) : transport_checksum(NET_PROTOCOL_TCP, buf, src_ip, dst_ip);
+    if (calc_checksum != checksum)
         return;
 
+    // 检查首部长度，并解析选项
+    uint32_t tcp_hdr_sz = (hdr->doff >> 4) * 4;
+    if (tcp_hdr_sz < sizeof(tcp_hdr_t) || tcp_hdr_sz > buf->len)
+        return;
+    tcp_opts_t opts;
+    tcp_parse_options(buf->data + sizeof(tcp_hdr_t), tcp_hdr_sz - sizeof(tcp_hdr_t), &opts);
+
     uint8_t *remote_ip = src_ip;
     uint16_t remote_port = swap16(hdr->src_port16);
     uint16_t host_port = swap16(hdr->dst_port16);
-    tcp_conn_t *tcp_conn = tcp_get_connection(remote_ip, remote_port, host_port, true);
+    tcp_key_t key = generate_tcp_key(remote_ip, remote_port, dst_ip, host_port, v6);
+    tcp_conn_t *tcp_conn = tcp_conn_lookup(&key);
 
     uint8_t recv_flags = hdr->flags;
-    // 收到 RST，关闭 TCP 连接
+    // TIME_WAIT 状态下收到序列号更大的新 SYN，释放旧连接，新 SYN 与其他新连接一样经过监听者的准入检查
+    if (tcp_conn && tcp_conn->state == TCP_STATE_TIME_WAIT && TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN) &&
+        !TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK) && TCP_SEQ_GT(swap32(hdr->seq), tcp_conn->ack)) {
+        tcp_conn_release(tcp_conn);
+        tcp_conn = NULL;
+    }
+    if (!tcp_conn) {
+        // 只为 SYN 分配连接，半连接过多或连接表已满时改用 SYN cookie 应答
+        if (TCP_FLG_ISSET(recv_flags, TCP_FLG_RST))
+            return;
+        // 端口上没有监听者，回复 RST，不分配连接
+        tcp_listener_t *listener = map_get(&tcp_listener_table, &host_port);
+        if (!listener) {
+            tcp_send_reset(&key, hdr, bytes_in_flight(buf->len - tcp_hdr_sz, recv_flags));
+            return;
+        }
+        if (TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN) && !TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK)) {
+            // 应用程序拒绝该连接
+            if (listener->opts.accept_handler && listener->opts.accept_handler(remote_ip, remote_port, host_port) != 0) {
+                tcp_send_reset(&key, hdr, bytes_in_flight(buf->len - tcp_hdr_sz, recv_flags));
+                return;
+            }
+            // 已建立连接数达到上限，丢弃 SYN，由对端稍后重传
+            if (listener->established_num >= listener->opts.accept_backlog)
+                return;
+            if (tcp_half_open_num < net_config.tcp_syn_cookie_threshold && listener->half_open_num < listener->opts.syn_backlog)
+                tcp_conn = tcp_get_connection(&key, true);
+            if (!tcp_conn) {
+                tcp_cookie_send_synack(&key, swap32(hdr->seq), &opts);
+                return;
+            }
+        } else if (TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK) && !TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN)) {
+            // 已建立连接数达到上限时不接受 cookie，丢弃 ACK，由对端重传
+            if (listener->established_num >= listener->opts.accept_backlog)
+                return;
+            tcp_conn = tcp_cookie_accept(&key, swap32(hdr->seq), swap32(hdr->ack), swap16(hdr->win));
+        }
+        // 未知连接的其他报文段回复 RST，不分配连接
+        if (!tcp_conn) {
+            tcp_send_reset(&key, hdr, bytes_in_flight(buf->len - tcp_hdr_sz, recv_flags));
+            return;
+        }
+    }
+
+    // 收到 RST，关闭 TCP 连接；序列号不在接收窗口内（SYN_SENT 状态下未确认本端 SYN）的 RST 被忽略，防止盲目重置
     if (TCP_FLG_ISSET(recv_flags, TCP_FLG_RST)) {
-        tcp_close_connection(remote_ip, remote_port, host_port);
+        uint32_t rst_offset = swap32(hdr->seq) - tcp_conn->ack;
+        uint32_t rcv_wnd = tcp_rcv_window(tcp_conn);
+        if (tcp_conn->state == TCP_STATE_SYN_SENT ? !TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK) || swap32(hdr->ack) != tcp_conn->seq : rst_offset >= (rcv_wnd ? rcv_wnd : 1))
+            return;
+        tcp_connect_done(tcp_conn, &key, -1);
+        tcp_close_done(tcp_conn, -1);
+        tcp_close_connection(&key);
         return;
     }
 
     uint32_t remote_seq = swap32(hdr->seq);
-    uint32_t tcp_hdr_sz = (hdr->doff >> 4) * 4;
+    // 对端仍然存活，重新开始保活计时
+    tcp_conn->last_recv = clock_ms();
+    tcp_conn->probes_sent = 0;
+    uint32_t remote_win = swap16(hdr->win);
+    if (!TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN))
+        remote_win <<= tcp_conn->snd_wscale;
+
+    if (tcp_conn->ts_ok && opts.ts_ok && tcp_conn->state != TCP_STATE_SYN_SENT) {
+        // PAWS：时间戳早于最近记录值的报文段是旧连接或回绕的重复报文段，回复 ACK 后丢弃
+        if (TCP_SEQ_LT(opts.ts_val, tcp_conn->ts_recent)) {
+            buf_init(&txbuf, 0);
+            tcp_out(tcp_conn, &txbuf, host_port, remote_ip, remote_port, TCP_FLG_ACK);
+            return;
+        }
+        if (TCP_SEQ_LEQ(remote_seq, tcp_conn->ack_sent))
+            tcp_conn->ts_recent = opts.ts_val;
+    }
+
+    // 应用程序的回调可能关闭并释放连接，此后不能再访问 tcp_conn，以句柄检查连接是否仍然存在
+    tcp_handle_t handle = tcp_conn_handle(tcp_conn);
 
-    /* Step1 ：根据接收包数据更新当前 TCP 连接内部状态，并填写回复报文的标志部分。 */
+    // 处理确认信息：累计确认、SACK 记分板与快速重传
+    if (tcp_conn->state != TCP_STATE_LISTEN && TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK)) {
+        uint8_t maybe_dup = buf->len == tcp_hdr_sz && !TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN | TCP_FLG_FIN) && remote_win == tcp_conn->snd_wnd;
+        uint32_t old_una = tcp_conn->una;
+        tcp_ack_in(tcp_conn, &key, swap32(hdr->ack), &opts, remote_win, maybe_dup);
+        // 确认了新数据，发送队列腾出了空间，通知应用程序继续写入
+        if (tcp_conn->una != old_una && tcp_conn->writable_handler && (tcp_conn->state == TCP_STATE_ESTABLISHED || tcp_conn->state == TCP_STATE_CLOSE_WAIT)) {
+            tcp_conn->writable_handler(tcp_conn, tcp_conn->txq ? TCP_TXQ_BUF_LEN - tcp_conn->txq->len : TCP_TXQ_BUF_LEN, remote_ip, remote_port);
+            if (!tcp_conn_get(handle))
+                return;
+        }
+    }
+
+    /* Step1 ：根据接收包数据更新当前 TCP 连接内部状态，将顺序数据交付给上层应用，并填写回复报文的标志部分。 */
 
     uint8_t send_flags = 0;  // 回复报文的标志位字段
+    uint8_t ack_now = 0;     // 是否需要立即确认，不进行延迟确认
 
      // 根据当前 TCP 连接的状态进行不同的处理    
     switch ( tcp_conn->state ) {
@@ -181,48 +1481,207 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
             if (! TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN))
                 return;
             // 初始化 TCP 连接上下文（tcp_conn 结构体）的 seq 字段
-            tcp_conn->seq = tcp_generate_initial_seq();
+            tcp_conn->seq = tcp_generate_initial_seq(&key);
+            tcp_conn->una = tcp_conn->seq;
+            tcp_conn->snd_wnd = remote_win;
+            // 对端提供的选项在 SYN-ACK 中同样声明，协商启用
+            tcp_negotiate_options(tcp_conn, &opts);
             // 填写 TCP 连接上下文（tcp_conn 结构体）的 ack 字段
             tcp_conn->ack = remote_seq + 1;
             // 填写回复标志 send_flags
             send_flags = TCP_FLG_SYN | TCP_FLG_ACK;
-            // 进行状态转移
+            // 进行状态转移，计入半连接，由 tcp_poll() 重传 SYN-ACK
             tcp_conn->state = TCP_STATE_SYN_RECEIVED;
+            tcp_conn->passive = 1;
+            tcp_conn->half_open = 1;
+            tcp_half_open_num++;
+            tcp_listener_t *listener = map_get(&tcp_listener_table, &host_port);
+            if (listener)
+                listener->half_open_num++;
+            tcp_listener_inherit(tcp_conn, listener);
+            tcp_conn->syn_retries = 0;
+            tcp_conn->syn_due = clock_ms() + tcp_conn->rto;
+            tcp_timer_arm(tcp_conn);
+            break;
+
+        case TCP_STATE_SYN_SENT:
+            // 携带的确认号必须恰好确认本端的 SYN，否则回复 RST
+            if (TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK) && tcp_conn->una != tcp_conn->seq) {
+                tcp_send_reset(&key, hdr, bytes_in_flight(buf->len - tcp_hdr_sz, recv_flags));
+                return;
+            }
+            // 仅处理 SYN 报文
+            if (! TCP_FLG_ISSET(recv_flags, TCP_FLG_SYN))
+                return;
+            tcp_conn->ack = remote_seq + 1;
+            tcp_conn->snd_wnd = remote_win;
+            // 本端在 SYN 中提供了全部选项，以对端的回应为准
+            tcp_negotiate_options(tcp_conn, &opts);
+            if (! TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK)) {
+                // 双方同时打开：回复 SYN-ACK，等待对端确认
+                tcp_conn->state = TCP_STATE_SYN_RECEIVED;
+                buf_init(&txbuf, 0);
+                tcp_out_seq(tcp_conn, &txbuf, tcp_conn->una, host_port, remote_ip, remote_port, TCP_FLG_SYN | TCP_FLG_ACK);
+                return;
+            }
+            tcp_conn->state = TCP_STATE_ESTABLISHED;
+            // 先通知应用程序，其发送的数据可以顺带第三次握手的 ACK
+            tcp_connect_done(tcp_conn, &key, 0);
+            if (!tcp_conn_get(handle))
+                return;
+            send_flags = TCP_FLG_ACK;
+            ack_now = 1;
             break;
 
         case TCP_STATE_SYN_RECEIVED:
             // 仅在收到确认报文时（ACK 报文）才做出处理，否则直接返回
             if (! TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK))
                 return;
-            // 进行状态转移
+            // 确认号没有确认本端的 SYN，回复 RST，连接保持不变
+            if (tcp_conn->una != tcp_conn->seq) {
+                tcp_send_reset(&key, hdr, bytes_in_flight(buf->len - tcp_hdr_sz, recv_flags));
+                return;
+            }
+            // 进行状态转移，第三次握手的报文可能携带数据，继续按 ESTABLISHED 处理
             tcp_conn->state = TCP_STATE_ESTABLISHED;
-            break;
+            tcp_half_open_done(tcp_conn);
+            tcp_listener_established(tcp_conn, &key);
+            // 双方同时打开时，此时才完成主动打开
+            tcp_connect_done(tcp_conn, &key, 0);
+            if (!tcp_conn_get(handle))
+                return;
+            // fall through
 
         case TCP_STATE_ESTABLISHED:
-            // 未收到顺序包，丢弃并发送重复 ACK
+        case TCP_STATE_FIN_WAIT1:
+        case TCP_STATE_FIN_WAIT2: {
+            // 本端的 FIN 已被确认
+            if (tcp_conn->state == TCP_STATE_FIN_WAIT1 && tcp_conn->una == tcp_conn->seq)
+                tcp_conn->state = TCP_STATE_FIN_WAIT2;
+
+            uint8_t *data = buf->data + tcp_hdr_sz;
+            size_t data_len = buf->len - tcp_hdr_sz;
+            uint8_t recv_fin = TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN);
+
+            // 去掉与已接收数据重叠的部分，完全重复的报文段发送重复 ACK
+            if (TCP_SEQ_LT(remote_seq, tcp_conn->ack)) {
+                uint32_t dup_len = tcp_conn->ack - remote_seq;
+                if (dup_len >= data_len + recv_fin) {
+                    if (data_len || recv_fin) {
+                        buf_init(&txbuf, 0);
+                        tcp_out(tcp_conn, &txbuf, host_port, remote_ip, remote_port, TCP_FLG_ACK);
+                    }
+                    return;
+                }
+                data += dup_len;
+                data_len -= dup_len;
+                remote_seq = tcp_conn->ack;
+            }
+
+            // 未收到顺序包，放入乱序队列并发送重复 ACK
             if (remote_seq != tcp_conn->ack) {
+                tcp_ooo_t *ooo = tcp_conn->ooo;
+                if (!ooo && (ooo = tcp_buf_alloc())) {
+                    ooo->base = tcp_conn->ack;
+                    ooo->block_num = 0;
+                    ooo->fin = 0;
+                    tcp_conn->ooo = ooo;
+                }
+                if (ooo && tcp_ooo_insert(ooo, remote_seq, data, data_len) == 0 && recv_fin) {
+                    ooo->fin = 1;
+                    ooo->fin_seq = remote_seq + data_len;
+                }
                 buf_init(&txbuf, 0);
                 tcp_out(tcp_conn, &txbuf, host_port, remote_ip, remote_port, TCP_FLG_ACK);
                 return;
             }
-            // 计算接收到的数据长度，更新 ACK
-            tcp_conn->ack += (buf->len - tcp_hdr_sz);
+
+            // 更新 ACK，交付顺序数据；接收缓冲区放不下的部分连同 FIN 一起丢弃，立即通告缩小的窗口
+            size_t delivered = tcp_deliver(tcp_conn, data, data_len, remote_ip, remote_port, host_port);
+            if (!tcp_conn_get(handle))
+                return;
+            if (delivered < data_len) {
+                recv_fin = 0;
+                ack_now = 1;
+            }
+
+            // 顺序数据可能填补了空洞，继续交付乱序队列中已连续的数据，并立即确认
+            tcp_ooo_t *ooo = tcp_conn->ooo;
+            if (ooo) {
+                ack_now = 1;
+                tcp_ooo_advance(ooo, tcp_conn->ack);
+                if (ooo->block_num && ooo->blocks[0].left == tcp_conn->ack) {
+                    size_t run_len = ooo->blocks[0].right - ooo->blocks[0].left;
+                    tcp_deliver(tcp_conn, ooo->data, run_len, remote_ip, remote_port, host_port);
+                    if (!tcp_conn_get(handle))
+                        return;
+                    tcp_ooo_advance(ooo, tcp_conn->ack);
+                }
+                if (ooo->fin && ooo->fin_seq == tcp_conn->ack)
+                    recv_fin = 1;
+                if (ooo->block_num == 0 && (!ooo->fin || recv_fin)) {
+                    tcp_buf_free(ooo);
+                    tcp_conn->ooo = NULL;
+                }
+            }
+
             // 如果接收报文携带数据，则填写回复标志 send_flags 发送ACK
-            if (buf->len > tcp_hdr_sz)
+            if (data_len)
                 send_flags = TCP_FLG_ACK;
-            // 如果收到 FIN 报文，则增加 send_flags 相应标志位，并且进行状态转移
-            if (TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN)) {
-                send_flags = TCP_FLG_ACK | TCP_FLG_FIN;
-                tcp_conn->state = TCP_STATE_CLOSE_WAIT;
+            // 如果收到 FIN 报文，则确认 FIN 并进行状态转移
+            if (recv_fin) {
+                tcp_conn->ack += 1;
+                send_flags = TCP_FLG_ACK;
+                ack_now = 1;
+                switch (tcp_conn->state) {
+                    case TCP_STATE_ESTABLISHED:
+                        // 注册了关闭回调的应用程序停留在 CLOSE_WAIT，可以继续发送，自行决定何时关闭；
+                        // 否则随即关闭本端，FIN 与 ACK 合并发送。关闭失败时连接已被复位释放
+                        tcp_conn->state = TCP_STATE_CLOSE_WAIT;
+                        if (tcp_conn->close_handler)
+                            tcp_close_done(tcp_conn, 0);
+                        else if (tcp_conn_close(tcp_conn, host_port, remote_ip, remote_port) < 0)
+                            return;
+                        if (!tcp_conn_get(handle))
+                            return;
+                        break;
+                    case TCP_STATE_FIN_WAIT1:
+                        // 双方同时关闭
+                        tcp_conn->state = TCP_STATE_CLOSING;
+                        break;
+                    case TCP_STATE_FIN_WAIT2:
+                        tcp_time_wait(tcp_conn, &key);
+                        break;
+                    default:
+                        break;
+                }
             }
             break;
+        }
+
+        case TCP_STATE_CLOSE_WAIT:
+            // 对端已关闭，不再接收数据，只处理确认信息
+            break;
+
+        case TCP_STATE_CLOSING:
+            // 本端的 FIN 被确认后进入 TIME_WAIT
+            if (tcp_conn->una == tcp_conn->seq)
+                tcp_time_wait(tcp_conn, &key);
+            break;
 
         case TCP_STATE_LAST_ACK:
-            // 仅在收到确认报文时（ACK 报文）才做出处理，否则直接返回
-            if (! TCP_FLG_ISSET(recv_flags, TCP_FLG_ACK))
-                return;
-            // 关闭 TCP 连接
-            tcp_close_connection(remote_ip, remote_port, host_port);
+            // 本端的 FIN 被确认后关闭 TCP 连接
+            if (tcp_conn->una == tcp_conn->seq)
+                tcp_close_connection(&key);
+            break;
+
+        case TCP_STATE_TIME_WAIT:
+            // 对端重传了 FIN，说明 ACK 丢失，重新确认并重启 2MSL 计时器
+            if (TCP_FLG_ISSET(recv_flags, TCP_FLG_FIN)) {
+                tcp_time_wait(tcp_conn, &key);
+                buf_init(&txbuf, 0);
+                tcp_out(tcp_conn, &txbuf, host_port, remote_ip, remote_port, TCP_FLG_ACK);
+            }
             break;
 
         default:
@@ -230,22 +1689,21 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
             break;
     }
 
-    /* Step2 ：如果接收报文携带数据，则将数据部分交付给上层应用 */
-    if (buf->len - tcp_hdr_sz > 0) {
-        tcp_handler_t *handler = map_get(&tcp_handler_table, &host_port);
-        if ( handler )
-            (*handler)(tcp_conn, buf->data + tcp_hdr_sz, buf->len - tcp_hdr_sz,remote_ip,remote_port);
-    }
-
-    /* Step3 ：调用tcp_out()发送回复报文，更新TCP连接序列号。 */
+    /* Step2 ：调用tcp_out()发送回复报文，更新TCP连接序列号。 */
     // 如果无需回复，则接收逻辑结束
     if (send_flags == 0)
         return;
-    // 如果 send_flags 只标识了 ACK 字段，并且应用程序已通过 tcp_send() 发送顺带 ACK，则无需再进行回复
-    if (bytes_in_flight(0, send_flags) == 0 && tcp_conn->not_send_empty_ack) {
-        assert(TCP_FLG_ISSET(send_flags, TCP_FLG_ACK));
-        tcp_conn->not_send_empty_ack = 0;
-        return;
+    // 如果 send_flags 只标识了 ACK 字段，并且应用程序已通过 tcp_send() 发送顺带 ACK，则无需再进行回复；
+    // 否则延迟确认，每收到 TCP_DELAYED_ACK_SEGS 个报文段或延迟确认计时器到期时再发送
+    if (bytes_in_flight(0, send_flags) == 0) {
+        if (tcp_conn->ack_sent == tcp_conn->ack)
+            return;
+        if (!ack_now && tcp_conn->ack_pending++ == 0) {
+            tcp_conn->ack_due = clock_ms() + TCP_DELAYED_ACK_MS;
+            tcp_timer_arm(tcp_conn);
+        }
+        if (!ack_now && tcp_conn->ack_pending < TCP_DELAYED_ACK_SEGS)
+            return;
     }
 
     // 初始化一个新的缓冲区，发送回复报文
@@ -258,7 +1716,36 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
 }
 
 /**
- * @brief 发送一个 TCP 包
+ * @brief 处理一个收到的 TCP 数据包
+ *
+ * @param buf       要处理的包
+ * @param src_ip    源 IP 地址
+ */
+void tcp_in(buf_t *buf, uint8_t *src_ip) {
+    // 不接受发往广播或组播地址的报文段
+    if (net_if_lookup(ip_in_dst) < 0)
+        return;
+    tcp_in_family(buf, src_ip, ip_in_dst, 0);
+}
+
+#ifdef IPV6
+/**
+ * @brief 处理一个收到的 ipv6 TCP 数据包
+ *
+ * @param buf       要处理的包
+ * @param src_ip    源 ipv6 地址
+ */
+void tcp6_in(buf_t *buf, uint8_t *src_ip) {
+    // 不接受发往组播地址的报文段
+    if (net_if_lookup6(ip6_in_dst) < 0)
+        return;
+    tcp_in_family(buf, src_ip, ip6_in_dst, 1);
+}
+#endif
+
+/**
+ * @brief 发送一个 TCP 包：数据先放入发送队列，按对端的 MSS 切分并按 Nagle 算法发出
+ * 发送队列剩余空间不足时只接受能放下的部分，应用程序应在对端确认后重新提交其余数据
  *
  * @param tcp_conn  指向当前 TCP 连接的指针
  * @param data      要发送的数据
@@ -266,29 +1753,213 @@ void tcp_in(buf_t *buf, uint8_t *src_ip) {
  * @param src_port  源端口号
  * @param dst_ip    目的ip地址
  * @param dst_port  目的端口号
+ * @return int      被接受的字节数，可能小于 len；连接不在可发送的状态或发送队列不可用时为-1
  */
-void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
-    // 检查payload长度是否合法
-    if (len > TCP_MAX_WINDOW_SIZE) {
-        printf("package is too big [max value = %d, current value = %d], please split it into small pieces in the user functions.\n", TCP_MAX_WINDOW_SIZE, len);
-        return;
+int tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    if (tcp_conn->state != TCP_STATE_ESTABLISHED && tcp_conn->state != TCP_STATE_CLOSE_WAIT)
+        return -1;
+    if (len == 0)
+        return 0;
+    tcp_conn->last_active = clock_ms();
+
+    tcp_key_t key = generate_tcp_key(dst_ip, dst_port, tcp_conn->key.local_ip, src_port, tcp_conn->key.v6);
+    int queued = tcp_txq_push(tcp_conn, data, len);
+    if (queued > 0)
+        tcp_output(tcp_conn, &key, 0);
+    return queued;
+}
+
+/**
+ * @brief 设置连接是否禁用 Nagle 算法，禁用后不足 MSS 的数据也立即发送
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param nodelay   为 1 时禁用 Nagle 算法
+ */
+void tcp_set_nodelay(tcp_conn_t *tcp_conn, uint8_t nodelay) {
+    tcp_conn->nodelay = nodelay;
+}
+
+/**
+ * @brief 塞住连接：此后只发出满 MSS 的报文段，不足 MSS 的数据暂缓到 tcp_flush()
+ * 适合连续多次调用 tcp_send() 写出一个完整的应用层消息
+ *
+ * @param tcp_conn  当前 TCP 连接
+ */
+void tcp_cork(tcp_conn_t *tcp_conn) {
+    tcp_conn->corked = 1;
+}
+
+/**
+ * @brief 解除 cork，立即发出发送队列中的全部数据
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param src_port  源端口号
+ * @param dst_ip    目的ip地址
+ * @param dst_port  目的端口号
+ */
+void tcp_flush(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    tcp_key_t key = generate_tcp_key(dst_ip, dst_port, tcp_conn->key.local_ip, src_port, tcp_conn->key.v6);
+    tcp_conn->corked = 0;
+    tcp_output(tcp_conn, &key, 1);
+}
+
+/**
+ * @brief 应用程序主动关闭连接：在已排队的数据之后发送 FIN
+ * ESTABLISHED 进入 FIN_WAIT1，CLOSE_WAIT 进入 LAST_ACK，尚未建立的连接直接释放
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param src_port  源端口号
+ * @param dst_ip    目的ip地址
+ * @param dst_port  目的端口号
+ * @return int      连接仍然存在为0；连接已被释放（尚未建立，或 FIN 无法排队而复位）为-1，此后不能再访问 tcp_conn
+ */
+int tcp_conn_close(tcp_conn_t *tcp_conn, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    tcp_key_t key = generate_tcp_key(dst_ip, dst_port, tcp_conn->key.local_ip, src_port, tcp_conn->key.v6);
+    switch (tcp_conn->state) {
+        case TCP_STATE_SYN_RECEIVED:
+        case TCP_STATE_ESTABLISHED:
+            tcp_half_open_done(tcp_conn);
+            tcp_conn->state = TCP_STATE_FIN_WAIT1;
+            break;
+        case TCP_STATE_CLOSE_WAIT:
+            tcp_conn->state = TCP_STATE_LAST_ACK;
+            break;
+        case TCP_STATE_CLOSED:
+        case TCP_STATE_LISTEN:
+        case TCP_STATE_SYN_SENT:
+            tcp_close_connection(&key);
+            return -1;
+        default:
+            return 0;  // 已在关闭过程中
     }
-    if (len == 0) {
-        printf("no payload to send, skipping transmission.\n");
-        return;
+
+    // FIN 排在发送队列末尾，忽略 Nagle 算法与 cork 立即发出
+    tcp_conn->corked = 0;
+    if (tcp_txq_push(tcp_conn, NULL, 0) < 0) {
+        // 发送队列不可用，FIN 无法得到重传保护，改为复位连接
+        tcp_conn_abort(tcp_conn);
+        return -1;
     }
+    tcp_conn->txq->fin = 1;
+    tcp_output(tcp_conn, &key, 1);
+    return 0;
+}
 
-    // 发送数据包
-    buf_t tx_buf;
-    buf_init(&tx_buf, len);
-    if (data)
-        memcpy(tx_buf.data, data, len);
-    tcp_out(tcp_conn, &tx_buf, src_port, dst_ip, dst_port, TCP_FLG_ACK /* 顺带 ACK */);
+/**
+ * @brief 设置连接的关闭回调，此后收到 FIN 时连接停留在 CLOSE_WAIT，连接被复位或超时时也通知应用程序
+ *
+ * @param tcp_conn      当前 TCP 连接
+ * @param close_handler 关闭回调，为 NULL 时恢复为收到 FIN 后随即关闭本端
+ */
+void tcp_set_close_handler(tcp_conn_t *tcp_conn, tcp_close_handler_t close_handler) {
+    tcp_conn->close_handler = close_handler;
+}
 
-    // 更新序列号
-    tcp_conn->seq += bytes_in_flight(len, 0);
-    // 标注已 ACK
-    tcp_conn->not_send_empty_ack = 1;
+/**
+ * @brief 设置连接的可读回调，此后接收的数据先进入接收缓冲区，由应用程序调用 tcp_read() 读取
+ *
+ * @param tcp_conn          当前 TCP 连接
+ * @param readable_handler  可读回调，为 NULL 时恢复为直接交付给端口的处理程序
+ */
+void tcp_set_readable(tcp_conn_t *tcp_conn, tcp_readable_handler_t readable_handler) {
+    tcp_conn->readable_handler = readable_handler;
+}
+
+/**
+ * @brief 设置连接的可写回调，对端确认数据、发送队列腾出空间时调用，用于继续发送 tcp_send() 未能排队的数据
+ *
+ * @param tcp_conn          当前 TCP 连接
+ * @param writable_handler  可写回调，为 NULL 时不再通知
+ */
+void tcp_set_writable(tcp_conn_t *tcp_conn, tcp_writable_handler_t writable_handler) {
+    tcp_conn->writable_handler = writable_handler;
+}
+
+/**
+ * @brief 从连接的接收缓冲区读取数据，窗口明显打开时向对端发送窗口更新
+ *
+ * @param tcp_conn  当前 TCP 连接
+ * @param data      读取的数据存放的位置
+ * @param len       最多读取的字节数
+ * @return size_t   实际读取的字节数
+ */
+size_t tcp_read(tcp_conn_t *tcp_conn, uint8_t *data, size_t len) {
+    tcp_rxq_t *rxq = tcp_conn->rxq;
+    if (!rxq)
+        return 0;
+    if (len > rxq->len)
+        len = rxq->len;
+    memcpy(data, rxq->data, len);
+    rxq->len -= len;
+    memmove(rxq->data, rxq->data + len, rxq->len);
+
+    // 避免糊涂窗口综合征：窗口右边界至少前移一个 MSS 或半个缓冲区才通告
+    uint32_t threshold = TCP_DEFAULT_MSS < TCP_RXQ_BUF_LEN / 2 ? TCP_DEFAULT_MSS : TCP_RXQ_BUF_LEN / 2;
+    uint32_t edge = tcp_conn->ack + tcp_rcv_window(tcp_conn);
+    uint8_t receiving = tcp_conn->state == TCP_STATE_ESTABLISHED || tcp_conn->state == TCP_STATE_FIN_WAIT1 || tcp_conn->state == TCP_STATE_FIN_WAIT2;
+    if (receiving && tcp_conn != tcp_reading_conn && TCP_SEQ_GEQ(edge, tcp_conn->rcv_adv + threshold)) {
+        buf_t tx_buf;
+        buf_init(&tx_buf, 0);
+        tcp_out(tcp_conn, &tx_buf, tcp_conn->key.host_port, tcp_conn->key.remote_ip, tcp_conn->key.remote_port, TCP_FLG_ACK);
+    }
+    return len;
+}
+
+/**
+ * @brief 获取连接的句柄，应用程序可以在回调之外持有句柄，稍后通过它访问连接
+ *
+ * @param tcp_conn      当前 TCP 连接
+ * @return tcp_handle_t 连接句柄
+ */
+tcp_handle_t tcp_conn_handle(tcp_conn_t *tcp_conn) {
+    return (tcp_handle_t)tcp_conn->gen << 32 | (uint32_t)(tcp_conn - tcp_conn_pool);
+}
+
+/**
+ * @brief 根据句柄获取连接
+ *
+ * @param handle        连接句柄
+ * @return tcp_conn_t*  连接已释放或该位置已被新连接复用时为 NULL
+ */
+tcp_conn_t *tcp_conn_get(tcp_handle_t handle) {
+    uint32_t idx = (uint32_t)handle;
+    if (idx >= tcp_conn_pool_top)
+        return NULL;
+    tcp_conn_t *tcp_conn = &tcp_conn_pool[idx];
+    if (!tcp_conn->in_use || tcp_conn->gen != (uint32_t)(handle >> 32))
+        return NULL;
+    return tcp_conn;
+}
+
+/**
+ * @brief 通过句柄发送数据
+ *
+ * @param handle    连接句柄
+ * @param data      要发送的数据
+ * @param len       数据长度
+ * @return int      被接受的字节数，句柄失效或连接不可发送时为-1
+ */
+int tcp_handle_send(tcp_handle_t handle, uint8_t *data, uint16_t len) {
+    tcp_conn_t *tcp_conn = tcp_conn_get(handle);
+    if (!tcp_conn)
+        return -1;
+    tcp_key_t key = tcp_conn->key;
+    return tcp_send(tcp_conn, data, len, key.host_port, key.remote_ip, key.remote_port);
+}
+
+/**
+ * @brief 通过句柄主动关闭连接
+ *
+ * @param handle    连接句柄
+ * @return int      成功为0，句柄失效为-1
+ */
+int tcp_handle_close(tcp_handle_t handle) {
+    tcp_conn_t *tcp_conn = tcp_conn_get(handle);
+    if (!tcp_conn)
+        return -1;
+    tcp_key_t key = tcp_conn->key;
+    tcp_conn_close(tcp_conn, key.host_port, key.remote_ip, key.remote_port);
+    return 0;
 }
 
 /**
@@ -296,38 +1967,310 @@ void tcp_send(tcp_conn_t *tcp_conn, uint8_t *data, uint16_t len, uint16_t src_po
  *
  */
 void tcp_init() {
-    map_init(&tcp_handler_table, sizeof(uint16_t), sizeof(tcp_handler_t), 0, 0, NULL, NULL);
-    map_init(&tcp_conn_table, sizeof(tcp_key_t), sizeof(tcp_conn_t), 0, 0, NULL, NULL);
+    map_init(&tcp_listener_table, sizeof(uint16_t), sizeof(tcp_listener_t), 0, 0, NULL, NULL);
+    memset(tcp_conn_hash, 0, sizeof(tcp_conn_hash));
+    memset(tcp_port_conns, 0, sizeof(tcp_port_conns));
+    tcp_conn_pool_top = 0;
+    tcp_conn_free_list = NULL;
+    tcp_buf_pool_top = 0;
+    tcp_buf_free_list = NULL;
+    memset(tcp_timer_wheel, 0, sizeof(tcp_timer_wheel));
+    tcp_timer_tick = clock_ms() / TCP_TIMER_INTERVAL_MS;
     net_add_protocol(NET_PROTOCOL_TCP, tcp_in);
-    // 初始化随机数种子，为生成 TCP 初始序列号提供支持
-    srand(time(NULL));
+#ifdef IPV6
+    ip6_add_protocol(NET_PROTOCOL_TCP, tcp6_in);
+#endif
+    // 生成 SYN cookie 与连接表散列共用的密钥，初始序列号另用一个密钥
+    random_bytes(tcp_secret, sizeof(tcp_secret));
+    tcp_isn_init();
+    tcp_half_open_num = 0;
+}
+
+/**
+ * @brief 检查一个连接的重传计时器，超时则从最早未确认的数据开始重传，连续重传次数用尽则复位连接
+ *
+ */
+static void tcp_rto_fn(tcp_conn_t *tcp_conn) {
+    tcp_txq_t *txq = tcp_conn->txq;
+    tcp_key_t *key = &tcp_conn->key;
+    if (!txq)
+        return;
+    // 每次超时重传后重传超时时间加倍
+    uint64_t rto = (uint64_t)tcp_conn->rto << txq->backoff;
+    if (tcp_conn->una == tcp_conn->seq || clock_ms() - txq->rto_time < (rto < TCP_MAX_RTO_MS ? rto : TCP_MAX_RTO_MS))
+        return;
+    // 超时后对端可能已丢弃乱序数据，清空记分板并退出快速恢复
+    txq->sacked_num = 0;
+    tcp_conn->in_recovery = 0;
+    tcp_conn->dup_acks = 0;
+    size_t mss = tcp_send_mss(tcp_conn);
+    size_t in_flight = tcp_txq_sent_end(tcp_conn, txq) - txq->base;
+    if (in_flight == 0)
+        return;
+    // 连续重传均未得到确认，对端多半已不可达，复位连接并通知应用程序，释放占用的缓冲区
+    if (txq->retries >= net_config.tcp_data_retries) {
+        tcp_conn_abort(tcp_conn);
+        return;
+    }
+    txq->retries++;
+    tcp_txq_send(tcp_conn, key, txq, txq->base, in_flight < mss ? in_flight : mss);
+    txq->rexmit_next = txq->base;
+    txq->rto_time = clock_ms();
+    if (rto < TCP_MAX_RTO_MS)
+        txq->backoff++;
+}
+
+/**
+ * @brief 检查一个连接的计时器：TIME_WAIT 到期则释放连接，SYN 或 SYN-ACK 超时则重传，
+ * 坚持计时器到期则发送零窗口探测，延迟确认到期则发送 ACK
+ *
+ */
+static void tcp_conn_timer_fn(tcp_conn_t *tcp_conn) {
+    tcp_key_t *tcp_key = &tcp_conn->key;
+    if (tcp_conn->state == TCP_STATE_TIME_WAIT) {
+        if (clock_ms() >= tcp_conn->time_wait_due)
+            tcp_close_connection(tcp_key);
+        return;
+    }
+    if (tcp_conn->state == TCP_STATE_SYN_SENT || (tcp_conn->state == TCP_STATE_SYN_RECEIVED && tcp_conn->syn_due)) {
+        if (clock_ms() < tcp_conn->syn_due)
+            return;
+        // 重传次数用尽，主动打开失败或释放半连接
+        if (tcp_conn->syn_retries >= TCP_SYN_RETRIES) {
+            tcp_connect_done(tcp_conn, tcp_key, -1);
+            tcp_close_connection(tcp_key);
+            return;
+        }
+        tcp_conn->syn_retries++;
+        uint64_t rto = (uint64_t)tcp_conn->rto << tcp_conn->syn_retries;
+        tcp_conn->syn_due = clock_ms() + (rto < TCP_MAX_RTO_MS ? rto : TCP_MAX_RTO_MS);
+        tcp_send_syn(tcp_conn, tcp_key);
+        return;
+    }
+    tcp_txq_t *txq = tcp_conn->txq;
+    if (tcp_conn->persist_due && clock_ms() >= tcp_conn->persist_due) {
+        tcp_conn->persist_due = 0;
+        // 窗口仍然关闭时越过窗口发送一个字节，此后由重传计时器按指数退避重发，直到对端打开窗口
+        if (txq && tcp_conn->una == tcp_conn->seq && TCP_SEQ_LEQ(tcp_conn->una + tcp_conn->snd_wnd, tcp_conn->seq) &&
+            TCP_SEQ_LT(tcp_conn->seq, txq->base + txq->len + txq->fin)) {
+            txq->rto_time = clock_ms();
+            tcp_txq_send(tcp_conn, tcp_key, txq, tcp_conn->seq, 1);
+            tcp_conn->seq += 1;
+        }
+    }
+    if (!tcp_conn->ack_pending || clock_ms() < tcp_conn->ack_due)
+        return;
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    tcp_out(tcp_conn, &tx_buf, tcp_key->host_port, tcp_key->remote_ip, tcp_key->remote_port, TCP_FLG_ACK);
+}
+
+/**
+ * @brief 检查一个连接的空闲超时与保活：长时间没有数据收发则释放，长时间未收到报文段则发送保活探测，
+ * 探测均无回应则释放
+ *
+ */
+static void tcp_keepalive_fn(tcp_conn_t *tcp_conn) {
+    uint64_t now = clock_ms();
+    if (tcp_conn->state < TCP_STATE_ESTABLISHED || tcp_conn->state == TCP_STATE_TIME_WAIT)
+        return;
+    if (tcp_conn->idle_timeout && now - tcp_conn->last_active >= tcp_conn->idle_timeout) {
+        tcp_conn_abort(tcp_conn);
+        return;
+    }
+    // 只在连接空闲且没有未确认数据时探测，否则由重传计时器判断对端是否存活
+    if (!tcp_conn->keepalive_idle || tcp_conn->state != TCP_STATE_ESTABLISHED || tcp_conn->una != tcp_conn->seq)
+        return;
+    if (now - tcp_conn->last_recv < tcp_conn->keepalive_idle + (uint64_t)tcp_conn->probes_sent * tcp_conn->keepalive_interval)
+        return;
+    if (tcp_conn->probes_sent >= tcp_conn->keepalive_probes) {
+        tcp_conn_abort(tcp_conn);
+        return;
+    }
+    // 探测报文段的序列号为已确认的最后一个字节，对端必须回复 ACK
+    tcp_conn->probes_sent++;
+    buf_t tx_buf;
+    buf_init(&tx_buf, 0);
+    tcp_out_seq(tcp_conn, &tx_buf, tcp_conn->una - 1, tcp_conn->key.host_port, tcp_conn->key.remote_ip, tcp_conn->key.remote_port, TCP_FLG_ACK);
+}
+
+/**
+ * @brief 一次 TCP 轮询，每隔 TCP_TIMER_INTERVAL_MS 检查计时轮上经过的槽中的连接，
+ * 并从上次停下的位置起检查 TCP_SWEEP_BATCH 个连接的保活与空闲超时
+ *
+ */
+void tcp_poll() {
+    static uint64_t last_poll;
+    static size_t sweep_pos;
+    uint64_t now = clock_ms();
+    if (now - last_poll < TCP_TIMER_INTERVAL_MS)
+        return;
+    last_poll = now;
+    for (size_t i = 0; i < TCP_SWEEP_BATCH && tcp_conn_pool_top; i++) {
+        if (sweep_pos >= tcp_conn_pool_top)
+            sweep_pos = 0;
+        tcp_conn_t *tcp_conn = &tcp_conn_pool[sweep_pos++];
+        if (tcp_conn->in_use)
+            tcp_keepalive_fn(tcp_conn);
+    }
+    // 只处理已经完整经过的刻度，其中挂着的计时器都已到期；长时间未轮询时最多转一圈
+    uint64_t now_tick = now / TCP_TIMER_INTERVAL_MS;
+    if (now_tick - tcp_timer_tick > TCP_TIMER_WHEEL_SIZE)
+        tcp_timer_tick = now_tick - TCP_TIMER_WHEEL_SIZE;
+    while (tcp_timer_tick + 1 < now_tick) {
+        size_t slot = ++tcp_timer_tick & (TCP_TIMER_WHEEL_SIZE - 1);
+        tcp_conn_t *tcp_conn;
+        while ((tcp_conn = tcp_timer_wheel[slot])) {
+            tcp_timer_unlink(tcp_conn);
+            tcp_rto_fn(tcp_conn);
+            if (tcp_conn->in_use)
+                tcp_conn_timer_fn(tcp_conn);
+            if (tcp_conn->in_use)
+                tcp_timer_arm(tcp_conn);
+        }
+    }
 }
 
 /**
- * @brief 打开一个 TCP 端口并注册处理程序
+ * @brief 在一个 TCP 端口上创建监听者，端口已有监听者时更新其配置并保留连接计数
+ *
+ * @param port      端口号
+ * @param handler   处理程序
+ * @param opts      监听者配置，为 NULL 时沿用已有配置，新监听者使用默认的队列长度与保活参数、不限空闲时间且不注册回调
+ * @return int      成功为0，失败为-1
+ */
+int tcp_listen(uint16_t port, tcp_handler_t handler, tcp_listen_opts_t *opts) {
+    tcp_listener_t listener = {0};
+    tcp_listener_t *old = map_get(&tcp_listener_table, &port);
+    if (old)
+        listener = *old;
+    listener.handler = handler;
+    if (opts) {
+        listener.opts = *opts;
+    } else if (!old) {
+        listener.opts.syn_backlog = net_config.tcp_syn_backlog;
+        listener.opts.accept_backlog = net_config.tcp_accept_backlog;
+        listener.opts.keepalive_idle = TCP_KEEPALIVE_IDLE_MS;
+        listener.opts.keepalive_interval = TCP_KEEPALIVE_INTERVAL_MS;
+        listener.opts.keepalive_probes = TCP_KEEPALIVE_PROBES;
+    }
+    return map_set(&tcp_listener_table, &port, &listener);
+}
+
+/**
+ * @brief 打开一个 TCP 端口并注册处理程序，新监听者使用默认配置
  *
  * @param port      端口号
  * @param handler   处理程序
  * @return int      成功为0，失败为-1
  */
 int tcp_open(uint16_t port, tcp_handler_t handler) {
-    return map_set(&tcp_handler_table, &port, &handler);
+    return tcp_listen(port, handler, NULL);
 }
 
-static _Thread_local uint16_t close_port;
-static void close_port_fn(void *key, void *value, time_t *timestamp) {
-    tcp_key_t *tcp_key = key;
-    if (tcp_key->host_port == close_port) {
-        map_delete(&tcp_conn_table, key);
+/**
+ * @brief 为主动打开分配一个未被占用的本地端口
+ *
+ * @param dst_ip    目的ip地址
+ * @param dst_port  目的端口号
+ * @param local_ip  本端地址
+ * @param v6        是否为 ipv6 地址
+ * @return uint16_t 分配的端口号，无可用端口时为0
+ */
+static uint16_t tcp_ephemeral_port(uint8_t *dst_ip, uint16_t dst_port, uint8_t *local_ip, uint8_t v6) {
+    static uint16_t next_port = TCP_EPHEMERAL_PORT_MIN;
+    for (uint32_t i = TCP_EPHEMERAL_PORT_MIN; i <= UINT16_MAX; i++) {
+        uint16_t port = next_port;
+        next_port = next_port == UINT16_MAX ? TCP_EPHEMERAL_PORT_MIN : next_port + 1;
+        tcp_key_t key = generate_tcp_key(dst_ip, dst_port, local_ip, port, v6);
+        if (!map_get(&tcp_listener_table, &port) && !tcp_conn_lookup(&key))
+            return port;
     }
+    return 0;
+}
+
+/**
+ * @brief 主动打开一个 ipv4 或 ipv6 的 TCP 连接
+ *
+ */
+static int tcp_connect_family(uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, tcp_handler_t handler, tcp_connect_handler_t connect_handler, uint8_t v6) {
+    // 按路由选择本端地址，它与端口一起构成连接的键
+    uint8_t local_ip[NET_IP6_LEN];
+#ifdef IPV6
+    if (v6)
+        ip6_src_select(dst_ip, local_ip);
+    else
+#endif
+        ip_src_select(dst_ip, local_ip);
+    if (src_port == 0 && (src_port = tcp_ephemeral_port(dst_ip, dst_port, local_ip, v6)) == 0)
+        return -1;
+    tcp_key_t key = generate_tcp_key(dst_ip, dst_port, local_ip, src_port, v6);
+    if (tcp_conn_lookup(&key))
+        return -1;  // 该四元组已有连接
+    tcp_conn_t *tcp_conn = tcp_get_connection(&key, true);
+    if (!tcp_conn)
+        return -1;
+
+    tcp_conn->state = TCP_STATE_SYN_SENT;
+    tcp_conn->una = tcp_generate_initial_seq(&key);
+    tcp_conn->seq = tcp_conn->una + 1;
+    // 在 SYN 中提供本端支持的全部选项，收到 SYN-ACK 后按对端的回应协商
+    tcp_conn->wscale_ok = 1;
+    tcp_conn->rcv_wscale = TCP_WINDOW_SCALE;
+    tcp_conn->ts_ok = 1;
+    tcp_conn->sack_permitted = 1;
+    tcp_conn->handler = handler;
+    tcp_conn->connect_handler = connect_handler;
+    tcp_listener_inherit(tcp_conn, map_get(&tcp_listener_table, &src_port));
+    tcp_conn->syn_retries = 0;
+    tcp_conn->syn_due = clock_ms() + tcp_conn->rto;
+    tcp_timer_arm(tcp_conn);
+    tcp_send_syn(tcp_conn, &key);
+    return src_port;
+}
+
+/**
+ * @brief 主动打开一个 TCP 连接：发送 SYN，由 tcp_poll() 负责超时重传
+ * 连接建立、被拒绝或超时后调用 connect_handler，收到的数据交付给 handler
+ *
+ * @param src_port          本地端口号，为0时自动分配
+ * @param dst_ip            目的ip地址
+ * @param dst_port          目的端口号
+ * @param handler           数据处理程序，只用于该连接，不在本地端口上创建监听者；为 NULL 时交付给端口已注册的处理程序
+ * @param connect_handler   主动打开完成回调，可以为 NULL
+ * @return int              成功返回使用的本地端口号，失败为-1
+ */
+int tcp_connect(uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, tcp_handler_t handler, tcp_connect_handler_t connect_handler) {
+    return tcp_connect_family(src_port, dst_ip, dst_port, handler, connect_handler, 0);
+}
+
+#ifdef IPV6
+/**
+ * @brief 主动打开一个 ipv6 TCP 连接，用法同 tcp_connect()，回调收到的地址为16字节
+ *
+ * @param src_port          本地端口号，为0时自动分配
+ * @param dst_ip            目的ipv6地址
+ * @param dst_port          目的端口号
+ * @param handler           数据处理程序，只用于该连接，为 NULL 时交付给端口已注册的处理程序
+ * @param connect_handler   主动打开完成回调，可以为 NULL
+ * @return int              成功返回使用的本地端口号，失败为-1
+ */
+int tcp6_connect(uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port, tcp_handler_t handler, tcp_connect_handler_t connect_handler) {
+    return tcp_connect_family(src_port, dst_ip, dst_port, handler, connect_handler, 1);
 }
+#endif
+
 /**
- * @brief 关闭一个 TCP 端口
+ * @brief 关闭一个 TCP 端口，只释放挂在该端口上的连接
  */
 void tcp_close(uint16_t port) {
-    close_port = port;
-    map_foreach(&tcp_conn_table, close_port_fn);
-    map_delete(&tcp_handler_table, &port);
+    tcp_conn_t *tcp_conn = tcp_port_conns[port];
+    while (tcp_conn) {
+        tcp_conn_t *next = tcp_conn->port_next;
+        tcp_conn_release(tcp_conn);
+        tcp_conn = next;
+    }
+    map_delete(&tcp_listener_table, &port);
 }
 
 /* =============================== COMMON API =============================== */
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "tcp.h"
+
+#include "utils.h"
+
+/**
+ * @brief 生成初始序列号的 SipHash 密钥
+ *
+ */
+static uint8_t tcp_isn_secret[16];
+
+/**
+ * @brief 生成 TCP 连接的初始序列号（ISN），按 RFC 6528 取四元组的带密钥哈希加上每4微秒递增的时钟，
+ * 同一四元组的 ISN 单调递增，不同四元组之间无法相互推测
+ *
+ * @param key       连接的键
+ * @return uint32_t 初始序列号
+ */
+uint32_t tcp_generate_initial_seq(const tcp_key_t *key) {
+    const uint32_t *local = (const uint32_t *)key->local_ip, *remote = (const uint32_t *)key->remote_ip;
+    uint32_t words[] = {local[0], local[1], local[2], local[3], remote[0], remote[1], remote[2], remote[3], ((uint32_t)key->remote_port << 16) | key->host_port};
+    return (uint32_t)siphash24(tcp_isn_secret, words, sizeof(words)) + (uint32_t)(clock_us() / 4);
+}
+
+/**
+ * @brief 生成初始序列号的密钥
+ *
+ */
+void tcp_isn_init() {
+    random_bytes(tcp_isn_secret, sizeof(tcp_isn_secret));
+}
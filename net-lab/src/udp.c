@@ -2,6 +2,10 @@
 
 #include "icmp.h"
 #include "ip.h"
+#ifdef IPV6
+#include "icmp6.h"
+#include "ip6.h"
+#endif
 
 /**
  * @brief udp处理程序表
@@ -9,6 +13,14 @@
  */
 map_t udp_table;
 
+#ifdef IPV6
+/**
+ * @brief ipv6 udp处理程序表，与ipv4的端口相互独立
+ *
+ */
+map_t udp6_table;
+#endif
+
 /**
  * @brief 处理一个收到的udp数据包
  *
@@ -38,7 +50,7 @@ void udp_in(buf_t *buf, uint8_t *src_ip) {
     // 2.2 将校验和字段置0
     udp_hdr->checksum16 = 0;
     // 2.3 调用transport_checksum重新计算校验和（含伪头部）
-    uint16_t calc_checksum = transport_checksum(NET_PROTOCOL_UDP, buf, src_ip, net_if_ip);
+    uint16_t calc_checksum = transport_checksum(NET_PROTOCOL_UDP, buf, src_ip, ip_in_dst);
     // 2.4 对比校验和，不一致则丢弃
     if (calc_checksum != orig_checksum) {
         // 恢复原始校验和（不影响后续逻辑，仅保证缓冲区数据完整性）
@@ -95,12 +107,14 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
     udp_hdr->checksum16 = 0;
 
     // Step3: 计算并填充校验和 
-    // 调用transport_checksum计算UDP校验和（含伪头部）
-    udp_hdr->checksum16 = transport_checksum(NET_PROTOCOL_UDP, buf, net_if_ip, dst_ip);
+    // 按路由选择源地址，调用transport_checksum计算UDP校验和（含伪头部）
+    uint8_t src_ip[NET_IP_LEN];
+    ip_src_select(dst_ip, src_ip);
+    udp_hdr->checksum16 = transport_checksum(NET_PROTOCOL_UDP, buf, src_ip, dst_ip);
 
     // Step4: 发送UDP数据报 
-    // 调用ip_out发送，上层协议指定为UDP
-    ip_out(buf, dst_ip, NET_PROTOCOL_UDP);
+    // 调用ip_out_src以同一源地址发送，上层协议指定为UDP
+    ip_out_src(buf, src_ip, dst_ip, NET_PROTOCOL_UDP);
 }
 
 /**
@@ -110,6 +124,10 @@ void udp_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port)
 void udp_init() {
     map_init(&udp_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL);
     net_add_protocol(NET_PROTOCOL_UDP, udp_in);
+#ifdef IPV6
+    map_init(&udp6_table, sizeof(uint16_t), sizeof(udp_handler_t), 0, 0, NULL, NULL);
+    ip6_add_protocol(NET_PROTOCOL_UDP, udp6_in);
+#endif
 }
 
 /**
@@ -145,4 +163,99 @@ void udp_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, u
     buf_init(&txbuf, len);
     memcpy(txbuf.data, data, len);
     udp_out(&txbuf, src_port, dst_ip, dst_port);
-}
\ No newline at end of file
+}
+
+#ifdef IPV6
+/**
+ * @brief 处理一个收到的ipv6 udp数据包，ipv6下校验和不可省略
+ *
+ * @param buf 要处理的包
+ * @param src_ip 源ipv6地址
+ */
+void udp6_in(buf_t *buf, uint8_t *src_ip) {
+    if (buf->len < sizeof(udp_hdr_t))
+        return;
+    udp_hdr_t *udp_hdr = (udp_hdr_t *)buf->data;
+    uint16_t udp_total_len = swap16(udp_hdr->total_len16);
+    if (udp_total_len < sizeof(udp_hdr_t) || buf->len < udp_total_len)
+        return;
+    if (buf->len > udp_total_len)
+        buf_remove_padding(buf, buf->len - udp_total_len);
+    uint16_t orig_checksum = udp_hdr->checksum16;
+    if (orig_checksum == 0)
+        return;
+    udp_hdr->checksum16 = 0;
+    uint16_t calc_checksum = transport_checksum6(NET_PROTOCOL_UDP, buf, src_ip, ip6_in_dst);
+    udp_hdr->checksum16 = orig_checksum;
+    if (calc_checksum != orig_checksum)
+        return;
+    uint16_t dst_port = swap16(udp_hdr->dst_port16);
+    udp_handler_t *handler = map_get(&udp6_table, &dst_port);
+    if (handler == NULL) {
+        // 恢复包括扩展首部在内的ipv6首部，回复端口不可达
+        buf_add_header(buf, ip6_in_hdr_len);
+        icmp6_error(buf, src_ip, ICMP6_TYPE_UNREACH, ICMP6_CODE_PORT_UNREACH, 0);
+        return;
+    }
+    buf_remove_header(buf, sizeof(udp_hdr_t));
+    uint16_t src_port = swap16(udp_hdr->src_port16);
+    (*handler)(buf->data, buf->len, src_ip, src_port);
+}
+
+/**
+ * @brief 处理一个要发送的ipv6 udp数据包
+ *
+ * @param buf 要处理的包
+ * @param src_port 源端口号
+ * @param dst_ip 目的ipv6地址
+ * @param dst_port 目的端口号
+ */
+void udp6_out(buf_t *buf, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    buf_add_header(buf, sizeof(udp_hdr_t));
+    udp_hdr_t *udp_hdr = (udp_hdr_t *)buf->data;
+    udp_hdr->src_port16 = swap16(src_port);
+    udp_hdr->dst_port16 = swap16(dst_port);
+    udp_hdr->total_len16 = swap16(buf->len);
+    udp_hdr->checksum16 = 0;
+    uint8_t src_ip[NET_IP6_LEN];
+    ip6_src_select(dst_ip, src_ip);
+    uint16_t checksum = transport_checksum6(NET_PROTOCOL_UDP, buf, src_ip, dst_ip);
+    udp_hdr->checksum16 = checksum ? checksum : 0xffff;  // 计算结果为0时以全1表示
+    ip6_out(buf, src_ip, dst_ip, NET_PROTOCOL_UDP);
+}
+
+/**
+ * @brief 打开一个ipv6 udp端口并注册处理程序，处理程序收到的源地址为16字节
+ *
+ * @param port 端口号
+ * @param handler 处理程序
+ * @return int 成功为0，失败为-1
+ */
+int udp6_open(uint16_t port, udp_handler_t handler) {
+    return map_set(&udp6_table, &port, &handler);
+}
+
+/**
+ * @brief 关闭一个ipv6 udp端口
+ *
+ * @param port 端口号
+ */
+void udp6_close(uint16_t port) {
+    map_delete(&udp6_table, &port);
+}
+
+/**
+ * @brief 发送一个ipv6 udp包
+ *
+ * @param data 要发送的数据
+ * @param len 数据长度
+ * @param src_port 源端口号
+ * @param dst_ip 目的ipv6地址
+ * @param dst_port 目的端口号
+ */
+void udp6_send(uint8_t *data, uint16_t len, uint16_t src_port, uint8_t *dst_ip, uint16_t dst_port) {
+    buf_init(&txbuf, len);
+    memcpy(txbuf.data, data, len);
+    udp6_out(&txbuf, src_port, dst_ip, dst_port);
+}
+#endif
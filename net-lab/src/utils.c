@@ -16,6 +16,41 @@ char *iptos(uint8_t *ip) {
     return output;
 }
 
+/**
+ * @brief ipv6地址转字符串，按 RFC 5952 以 :: 压缩最长的连续全0分组
+ *
+ * @param ip ipv6地址
+ * @return char* 生成的字符串
+ */
+char *ip6tos(const uint8_t *ip) {
+    static char output[8 * 5 + 1];
+    uint16_t words[8];
+    for (int i = 0; i < 8; i++)
+        words[i] = ip[2 * i] << 8 | ip[2 * i + 1];
+    int best = -1, best_len = 1;  // 只压缩至少两个分组
+    for (int i = 0; i < 8;) {
+        int j = i;
+        while (j < 8 && words[j] == 0)
+            j++;
+        if (j - i > best_len) {
+            best = i;
+            best_len = j - i;
+        }
+        i = j > i ? j : i + 1;
+    }
+    char *p = output;
+    for (int i = 0; i < 8; i++) {
+        if (i == best) {
+            p += sprintf(p, "::");
+            i += best_len - 1;
+            continue;
+        }
+        p += sprintf(p, "%s%x", (i == 0 || i == best + best_len) ? "" : ":", words[i]);
+    }
+    *p = '\0';
+    return output;
+}
+
 /**
  * @brief mac转字符串
  *
@@ -41,6 +76,61 @@ char *timetos(time_t timestamp) {
     return output;
 }
 
+#define SIPROUND(v0, v1, v2, v3)                                   \
+    do {                                                           \
+        v0 += v1, v1 = (v1 << 13) | (v1 >> 51), v1 ^= v0;          \
+        v0 = (v0 << 32) | (v0 >> 32);                              \
+        v2 += v3, v3 = (v3 << 16) | (v3 >> 48), v3 ^= v2;          \
+        v0 += v3, v3 = (v3 << 21) | (v3 >> 43), v3 ^= v0;          \
+        v2 += v1, v1 = (v1 << 17) | (v1 >> 47), v1 ^= v2;          \
+        v2 = (v2 << 32) | (v2 >> 32);                              \
+    } while (0)
+
+/**
+ * @brief SipHash-2-4 带密钥的哈希，用于生成对端无法预测的序列号、cookie 与散列
+ *
+ * @param key 128位密钥
+ * @param data 数据
+ * @param len 数据长度
+ * @return uint64_t 哈希值
+ */
+uint64_t siphash24(const uint8_t key[16], const void *data, size_t len) {
+    const uint8_t *in = data;
+    uint64_t k0 = 0, k1 = 0;
+    for (int i = 0; i < 8; i++) {
+        k0 |= (uint64_t)key[i] << (8 * i);
+        k1 |= (uint64_t)key[i + 8] << (8 * i);
+    }
+    uint64_t v0 = k0 ^ 0x736f6d6570736575ULL;
+    uint64_t v1 = k1 ^ 0x646f72616e646f6dULL;
+    uint64_t v2 = k0 ^ 0x6c7967656e657261ULL;
+    uint64_t v3 = k1 ^ 0x7465646279746573ULL;
+
+    size_t blocks = len / 8;
+    for (size_t i = 0; i < blocks; i++) {
+        uint64_t m = 0;
+        for (int j = 0; j < 8; j++)
+            m |= (uint64_t)in[i * 8 + j] << (8 * j);
+        v3 ^= m;
+        SIPROUND(v0, v1, v2, v3);
+        SIPROUND(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    // 最后一个分组：剩余字节，最高字节为总长度
+    uint64_t b = (uint64_t)len << 56;
+    for (size_t j = 0; j < len % 8; j++)
+        b |= (uint64_t)in[blocks * 8 + j] << (8 * j);
+    v3 ^= b;
+    SIPROUND(v0, v1, v2, v3);
+    SIPROUND(v0, v1, v2, v3);
+    v0 ^= b;
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; i++)
+        SIPROUND(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
 /**
  * @brief ip前缀匹配
  *
@@ -70,19 +160,41 @@ uint8_t ip_prefix_match(uint8_t *ipa, uint8_t *ipb) {
  * @return uint16_t 校验和
  */
 uint16_t checksum16(uint16_t *data, size_t len) {
+    return checksum_finish(checksum_partial(0, data, len));
+}
+
+/**
+ * @brief 累加部分校验和，用于预先计算首部中的固定字段
+ *
+ * @param sum 已有的部分校验和
+ * @param data 要累加的数据，除最后一段外长度必须为偶数
+ * @param len 要累加的长度
+ * @return uint32_t 未折叠、未取反的部分校验和
+ */
+uint32_t checksum_partial(uint32_t sum, const void *data, size_t len) {
     // Step1: 按16位分组累加，用32位变量保存和（避免溢出）
-    uint32_t sum = 0;
+    const uint16_t *words = data;
     size_t i;
     // 遍历所有16位分组
     for (i = 0; i < len / 2; i++) {
-        sum += data[i]; // 16位分组依次相加
+        sum += words[i]; // 16位分组依次相加
     }
     // Step2: 处理剩余的8位（若总长度为奇数）
     if (len % 2 != 0) {
         // 剩余1个字节，拼接为16位（高8位补0）
-        uint8_t last_byte = *((uint8_t *)data + len - 1);
+        uint8_t last_byte = *((const uint8_t *)data + len - 1);
         sum += (uint16_t)last_byte;
     }
+    return sum;
+}
+
+/**
+ * @brief 由部分校验和得到最终的16位校验和
+ *
+ * @param sum 部分校验和
+ * @return uint16_t 校验和
+ */
+uint16_t checksum_finish(uint32_t sum) {
     // Step3: 循环处理高16位，直至高16位为0
     while (sum >> 16) {
         // 高16位 + 低16位
@@ -93,16 +205,6 @@ uint16_t checksum16(uint16_t *data, size_t len) {
     return (uint16_t)~sum;
 }
 
-#pragma pack(1)
-typedef struct peso_hdr {
-    uint8_t src_ip[4];     // 源IP地址
-    uint8_t dst_ip[4];     // 目的IP地址
-    uint8_t placeholder;   // 必须置0,用于填充对齐
-    uint8_t protocol;      // 协议号
-    uint16_t total_len16;  // 整个数据包的长度
-} peso_hdr_t;
-#pragma pack()
-
 /**
  * @brief 计算传输层协议（如TCP/UDP）的校验和
  *
@@ -151,4 +253,20 @@ uint16_t transport_checksum(uint8_t protocol, buf_t *buf, uint8_t *src_ip, uint8
 
     // Step7: 返回校验和值 
     return checksum;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief 计算ipv6上层协议（如TCP/UDP/ICMPv6）的校验和，伪首部单独累加，不改动缓冲区
+ *
+ * @param protocol 上层协议号
+ * @param buf 要计算的数据包，校验和字段须已置0
+ * @param src_ip 源ipv6地址
+ * @param dst_ip 目的ipv6地址
+ * @return uint16_t 校验和
+ */
+uint16_t transport_checksum6(uint8_t protocol, buf_t *buf, const uint8_t *src_ip, const uint8_t *dst_ip) {
+    peso6_hdr_t pseudo = {.total_len32 = swap32((uint32_t)buf->len), .next_header = protocol};
+    memcpy(pseudo.src_ip, src_ip, sizeof(pseudo.src_ip));
+    memcpy(pseudo.dst_ip, dst_ip, sizeof(pseudo.dst_ip));
+    return checksum_finish(checksum_partial(checksum_partial(0, &pseudo, sizeof(pseudo)), buf->data, buf->len));
+}
@@ -35,8 +35,14 @@ void arp_out(buf_t *buf, uint8_t *ip) {
     fprint_buf(arp_fout, buf);
 }
 
+uint32_t arp_gen = 1;
+
+uint8_t *arp_lookup(uint8_t *ip) {
+    return NULL;
+}
+
 void arp_init() {
-    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, 0, ARP_TIMEOUT_SEC, NULL, NULL);
-    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, ARP_MIN_INTERVAL, NULL, buf_copy);
+    map_init(&arp_table, NET_IP_LEN, NET_MAC_LEN, net_config.arp_max_num, net_config.arp_timeout_sec, NULL, NULL);
+    map_init(&arp_buf, NET_IP_LEN, sizeof(buf_t), 0, net_config.arp_min_interval_sec, NULL, buf_copy);
     net_add_protocol(NET_PROTOCOL_ARP, arp_in);
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#include "utils.h"
+
+// 测试用时钟，只由测试程序推进，从1秒开始以免与表示未设置的0混淆
+uint64_t test_clock_us = 1000000;
+
+uint64_t clock_ms() {
+    return test_clock_us / 1000;
+}
+
+uint64_t clock_us() {
+    return test_clock_us;
+}
@@ -11,6 +11,7 @@ static char pcap_errbuf[PCAP_ERRBUF_SIZE];
 extern FILE *pcap_in;
 extern FILE *pcap_out;
 extern FILE *control_flow;
+extern uint64_t test_clock_us;
 
 #ifdef _WIN32
 #include <tchar.h>
@@ -63,6 +64,15 @@ int driver_recv(buf_t *buf) {
         // printf("meet end of file\n");
         return 0;
     } else if (ret == 1) {
+        // 以第一个报文的时间戳为起点，按输入报文的时间戳推进测试时钟，时间戳回退时不动
+        static uint64_t ts_base, clock_base;
+        uint64_t ts = (uint64_t)pkt_hdr->ts.tv_sec * 1000000 + pkt_hdr->ts.tv_usec;
+        if (!clock_base) {
+            ts_base = ts;
+            clock_base = test_clock_us;
+        }
+        if (ts > ts_base && clock_base + ts - ts_base > test_clock_us)
+            test_clock_us = clock_base + ts - ts_base;
         buf_init(buf, pkt_hdr->len);
         memcpy(buf->data, pkt_data, pkt_hdr->len);
         return pkt_hdr->len;
@@ -81,6 +91,18 @@ int driver_send(buf_t *buf) {
     return 0;
 }
 
+int driver_recv_if(int ifindex, buf_t *buf) {
+    return ifindex == 0 ? driver_recv(buf) : 0;
+}
+
+int driver_send_if(int ifindex, buf_t *buf) {
+    return ifindex == 0 ? driver_send(buf) : -1;
+}
+
+int driver_update_filter(int ifindex) {
+    return 0;
+}
+
 void driver_close() {
     fprintf(control_flow, "\ndriver closed\n");
     pcap_dump_close(pdump);
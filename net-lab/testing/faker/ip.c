@@ -1,4 +1,4 @@
-#include "net.h"
+#include "ip.h"
 
 #include <stdio.h>
 #include <string.h>
@@ -18,7 +18,7 @@ void ip_in(buf_t *buf, uint8_t *src_mac) {
     fprint_buf(ip_fout, buf);
 }
 
-void ip_fragment_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
+void ip_fragment_out(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol, int id, uint16_t offset, int mf) {
     fprintf(ip_fout, "ip_fragment_out:\n");
     fprintf(ip_fout, "\tip: %s\n", print_ip(ip));
     fprintf(ip_fout, "\tprotocol: %d\n", protocol);
@@ -35,6 +35,37 @@ void ip_out(buf_t *buf, uint8_t *ip, net_protocol_t protocol) {
     fprint_buf(ip_fout, buf);
 }
 
+void ip_out_src(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    ip_out(buf, ip, protocol);
+}
+
+void ip_out_pmtu(buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    ip_out(buf, ip, protocol);
+}
+
+void ip_out_tmpl(ip_tmpl_t *tmpl, buf_t *buf, uint8_t *src, uint8_t *ip, net_protocol_t protocol) {
+    ip_out(buf, ip, protocol);
+}
+
+uint8_t ip_in_dst[NET_IP_LEN] = NET_IF_IP;
+
+void ip_src_select(uint8_t *ip, uint8_t *src) {
+    memcpy(src, net_if_ip, NET_IP_LEN);
+}
+
+int ip_route_add(uint8_t *dst, uint8_t *netmask, uint8_t *gateway, uint32_t metric) {
+    return 0;
+}
+
+uint32_t ip_pmtu_gen = 1;
+
+uint16_t ip_pmtu(uint8_t *ip) {
+    return net_config.mtu;
+}
+
 void ip_init() {
     net_add_protocol(NET_PROTOCOL_IP, ip_in);
+}
+
+void ip_poll() {
 }
\ No newline at end of file
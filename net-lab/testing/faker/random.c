@@ -0,0 +1,13 @@
+#include "utils.h"
+
+// 测试用随机数，以固定种子的 xorshift 生成，使 SYN cookie 与连接表哈希等依赖密钥的输出可以逐字节比对
+static uint64_t test_random_state = 0x9e3779b97f4a7c15ULL;
+
+void random_bytes(uint8_t *buf, size_t len) {
+    for (size_t n = 0; n < len; n++) {
+        test_random_state ^= test_random_state << 13;
+        test_random_state ^= test_random_state >> 7;
+        test_random_state ^= test_random_state << 17;
+        buf[n] = test_random_state >> 32;
+    }
+}
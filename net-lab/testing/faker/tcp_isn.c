@@ -0,0 +1,10 @@
+#include "tcp.h"
+
+#define TCP_TEST_INITIAL_SEQ 1108428113  // 测试用TCP初始序列号，与测试数据中对端的确认号对齐
+
+uint32_t tcp_generate_initial_seq(const tcp_key_t *key) {
+    return TCP_TEST_INITIAL_SEQ;
+}
+
+void tcp_isn_init() {
+}
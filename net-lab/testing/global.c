@@ -64,6 +64,17 @@ FILE *open_file(char *path, char *name, char *mode) {
     return fopen(filename, mode);
 }
 
+// 测试目录中有 net.conf 时以其覆盖默认配置，须在 net_init() 之前调用
+void load_config(char *path) {
+    FILE *conf = open_file(path, "net.conf", "r");
+    if (conf) {
+        fclose(conf);
+        char conf_path[128];
+        sprintf(conf_path, "%s/net.conf", path);
+        net_config_load(conf_path);
+    }
+}
+
 ssize_t getline(char **lineptr, size_t *n, FILE *fp) {
     int i;
     if (*lineptr == NULL || *n < 256) {
@@ -396,9 +407,14 @@ CHECK_PCAP_NEXT_PACKET:
         goto CHECK_PCAP_NEXT_PACKET;
     }
 
-    // if (_check_pcap(idx, pkt_data0, pkt_data1, pkt_hdr0, pkt_hdr1)) {
-    //     goto CHECK_PCAP_NEXT_PACKET;
-    // }
+    // 测试中的 ISN、时钟与随机密钥都是确定的，序列号、时间戳、SACK 块与校验和也逐字节与示例比较
+    for (size_t i = 0; i < pkt_hdr0->len; i++) {
+        if (pkt_data0[i] != pkt_data1[i]) {
+            PRINT_WARN("Packet %d: byte %zu differs (demo: 0x%02x, user: 0x%02x)\n", idx, i, pkt_data0[i], pkt_data1[i]);
+            result = 1;
+            goto CHECK_PCAP_NEXT_PACKET;
+        }
+    }
 
     PRINT_PASS("Packet %d: no differences\n", idx);
     goto CHECK_PCAP_NEXT_PACKET;
@@ -24,6 +24,7 @@ uint8_t boardcast_mac[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 int check_log();
 int check_pcap();
 FILE *open_file(char *path, char *name, char *mode);
+void load_config(char *path);
 
 void log_tab_buf();
 
@@ -52,6 +53,7 @@ int main(int argc, char *argv[]) {
     udp_fout = control_flow;
     arp_log_f = control_flow;
 
+    load_config(argv[1]);
     net_init();
     log_tab_buf();
     int i = 1;
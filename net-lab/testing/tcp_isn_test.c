@@ -0,0 +1,70 @@
+#include "tcp.h"
+#include "testing/log.h"
+#include "utils.h"
+
+#include <string.h>
+
+extern uint64_t test_clock_us;
+
+static tcp_key_t make_key(uint8_t remote_last, uint16_t remote_port, uint8_t local_last, uint16_t host_port) {
+    tcp_key_t key;
+    memset(&key, 0, sizeof(key));
+    uint8_t remote_ip[] = {192, 168, 163, remote_last}, local_ip[] = {192, 168, 163, local_last};
+    memcpy(key.remote_ip, remote_ip, NET_IP_LEN);
+    memcpy(key.local_ip, local_ip, NET_IP_LEN);
+    key.remote_port = remote_port;
+    key.host_port = host_port;
+    return key;
+}
+
+static int check(int ok, const char *what) {
+    if (ok)
+        PRINT_PASS("%s\n", what);
+    else
+        PRINT_ERROR("%s\n", what);
+    return !ok;
+}
+
+int main(int argc, char *argv[]) {
+    int fail = 0;
+    PRINT_INFO("Test begin.\n");
+
+    // SipHash-2-4 参考实现的测试向量：密钥为 00..0f，消息为 00..0e
+    uint8_t secret[16], msg[15];
+    for (int i = 0; i < sizeof(secret); i++)
+        secret[i] = i;
+    for (int i = 0; i < sizeof(msg); i++)
+        msg[i] = i;
+    fail |= check(siphash24(secret, msg, sizeof(msg)) == 0xa129ca6149be45e5ULL, "siphash24 matches the reference test vector");
+
+    tcp_isn_init();
+    tcp_key_t key = make_key(10, 40000, 103, 60000);
+    uint32_t isn0 = tcp_generate_initial_seq(&key);
+    fail |= check(tcp_generate_initial_seq(&key) == isn0, "same 4-tuple at the same time gives the same ISN");
+
+    // 同一四元组的 ISN 随时钟每4微秒加1
+    test_clock_us += 4000;
+    uint32_t isn1 = tcp_generate_initial_seq(&key);
+    fail |= check(isn1 - isn0 == 1000, "same 4-tuple advances by one per 4 microseconds");
+    test_clock_us += 30 * 1000000ULL;
+    uint32_t isn2 = tcp_generate_initial_seq(&key);
+    fail |= check(isn2 - isn1 == 30 * 250000, "same 4-tuple keeps increasing over time");
+
+    // 四元组的任一部分不同，ISN 都不同，且差值不是时钟的增量
+    tcp_key_t others[] = {make_key(11, 40000, 103, 60000), make_key(10, 40001, 103, 60000),
+                          make_key(10, 40000, 104, 60000), make_key(10, 40000, 103, 60001)};
+    int distinct = 1;
+    for (int i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+        uint32_t isn = tcp_generate_initial_seq(&others[i]);
+        distinct &= isn != isn2;
+        for (int j = 0; j < i; j++)
+            distinct &= isn != tcp_generate_initial_seq(&others[j]);
+    }
+    fail |= check(distinct, "different 4-tuples give different ISNs");
+
+    if (fail)
+        PRINT_ERROR("====> Some ISN checks failed.\n");
+    else
+        PRINT_PASS("====> All ISN checks passed.\n");
+    return fail ? -1 : 0;
+}
@@ -26,6 +26,7 @@ uint8_t boardcast_mac[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 int check_log();
 int check_pcap();
 FILE *open_file(char *path, char *name, char *mode);
+void load_config(char *path);
 
 void log_tab_buf();
 
@@ -36,9 +37,102 @@ void tcp_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_i
         putchar('\n');
     fflush(stdout);
 
+    tcp_set_nodelay(tcp_conn, 1);                            // 交互式回显，不等待凑满报文段
     tcp_send(tcp_conn, data, len, 60000, src_ip, src_port);  // 发送tcp包
 }
 
+void tcp_nagle_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    tcp_send(tcp_conn, data, len, 60002, src_ip, src_port);  // 启用 Nagle 算法的回显
+}
+
+void tcp_close_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    tcp_cork(tcp_conn);
+    tcp_send(tcp_conn, data, len, 60003, src_ip, src_port);
+    tcp_conn_close(tcp_conn, 60003, src_ip, src_port);  // 回显后主动关闭，FIN 与数据合并发送
+}
+
+void tcp_client_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    for (int i = 0; i < len; i++)
+        putchar(data[i]);
+    if (len)
+        putchar('\n');
+    fflush(stdout);
+
+    tcp_conn_close(tcp_conn, 60004, src_ip, src_port);  // 收到回应后主动关闭
+}
+
+void tcp_client_connect_handler(tcp_conn_t *tcp_conn, uint8_t *dst_ip, uint16_t dst_port, int status) {
+    if (status == 0)
+        tcp_send(tcp_conn, (uint8_t *)"hello", 5, 60004, dst_ip, dst_port);
+}
+
+int tcp_listen_accept_handler(uint8_t *src_ip, uint16_t src_port, uint16_t dst_port) {
+    return src_port == 40000 ? -1 : 0;  // 拒绝来自 40000 端口的连接
+}
+
+void tcp_listen_established_handler(tcp_conn_t *tcp_conn, uint8_t *src_ip, uint16_t src_port) {
+    printf("established: %s:%u\n", print_ip(src_ip), src_port);
+    fflush(stdout);
+}
+
+void tcp_async_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    static tcp_handle_t first;  // 第一个连接的句柄，其后各连接收到的数据都转发给它
+    if (!first) {
+        first = tcp_conn_handle(tcp_conn);
+        return;
+    }
+    if (tcp_handle_send(first, data, len) < 0)
+        tcp_send(tcp_conn, (uint8_t *)"stale", 5, 60006, src_ip, src_port);  // 句柄已失效，告知当前连接
+}
+
+void tcp_record_handler(tcp_conn_t *tcp_conn, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    uint8_t record[6];  // 按6字节的定长记录读取，不足一条记录的数据留在接收缓冲区
+    for (; len >= sizeof(record); len -= sizeof(record)) {
+        tcp_read(tcp_conn, record, sizeof(record));
+        tcp_send(tcp_conn, record, sizeof(record), 60007, src_ip, src_port);
+    }
+}
+
+void tcp_halfclose_handler(tcp_conn_t *tcp_conn, uint8_t *src_ip, uint16_t src_port, int status) {
+    printf("closed: %s:%u %d\n", print_ip(src_ip), src_port, status);
+    fflush(stdout);
+    if (status != 0)
+        return;
+    tcp_send(tcp_conn, (uint8_t *)"bye", 3, 60010, src_ip, src_port);  // 对端关闭后本端仍可发送，之后再关闭
+    tcp_conn_close(tcp_conn, 60010, src_ip, src_port);
+}
+
+#define TCP_BULK_LEN 70000  // 超过发送队列容量的响应长度，其余部分须等发送队列腾出空间后再写入
+static size_t tcp_bulk_sent;
+
+void tcp_bulk_writable_handler(tcp_conn_t *tcp_conn, size_t len, uint8_t *dst_ip, uint16_t dst_port) {
+    uint8_t chunk[1000];
+    while (tcp_bulk_sent < TCP_BULK_LEN) {
+        size_t n = TCP_BULK_LEN - tcp_bulk_sent < sizeof(chunk) ? TCP_BULK_LEN - tcp_bulk_sent : sizeof(chunk);
+        for (size_t i = 0; i < n; i++)
+            chunk[i] = 'a' + (tcp_bulk_sent + i) % 26;
+        int queued = tcp_send(tcp_conn, chunk, n, 60011, dst_ip, dst_port);
+        if (queued <= 0)
+            return;  // 发送队列已满，等待下一次可写回调
+        tcp_bulk_sent += queued;
+    }
+    tcp_set_writable(tcp_conn, NULL);
+}
+
+void tcp_bulk_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    tcp_set_nodelay(tcp_conn, 1);
+    tcp_set_writable(tcp_conn, tcp_bulk_writable_handler);
+    tcp_bulk_writable_handler(tcp_conn, 0, src_ip, src_port);
+}
+
+void tcp_port_close_handler(tcp_conn_t *tcp_conn, uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    if (len == 5 && memcmp(data, "close", 5) == 0) {
+        tcp_close(60012);  // 释放该端口上的全部连接，包括当前连接
+        return;
+    }
+    tcp_send(tcp_conn, data, len, 60012, src_ip, src_port);
+}
+
 buf_t buf;
 int main(int argc, char *argv[]) {
     int ret;
@@ -65,14 +159,39 @@ int main(int argc, char *argv[]) {
     tcp_fout = control_flow;
     arp_log_f = control_flow;
 
+    load_config(argv[1]);
     net_init();
     tcp_open(60000, tcp_handler);  // 注册端口的tcp监听回调
+    tcp_open(60001, NULL);         // 只接收不回应的端口，用于检验延迟确认
+    tcp_open(60002, tcp_nagle_handler);
+    tcp_open(60003, tcp_close_handler);
+    // 队列长度均为1的监听者，用于检验过载时的处理
+    tcp_listen_opts_t listen_opts = {1, 1, tcp_listen_accept_handler, tcp_listen_established_handler};
+    tcp_listen(60005, tcp_handler, &listen_opts);
+    tcp_open(60006, tcp_async_handler);
+    tcp_listen_opts_t record_opts = {TCP_SYN_BACKLOG, TCP_ACCEPT_BACKLOG, NULL, NULL, tcp_record_handler};
+    tcp_listen(60007, NULL, &record_opts);
+    // 缩短保活与空闲超时时间的回显端口，由报文的时间戳推进时钟来检验
+    tcp_listen_opts_t keepalive_opts = {TCP_SYN_BACKLOG, TCP_ACCEPT_BACKLOG, .keepalive_idle = 2000, .keepalive_interval = 1000, .keepalive_probes = 2};
+    tcp_listen(60008, tcp_handler, &keepalive_opts);
+    tcp_listen_opts_t idle_opts = {TCP_SYN_BACKLOG, TCP_ACCEPT_BACKLOG, .idle_timeout = 3000};
+    tcp_listen(60009, tcp_handler, &idle_opts);
+    tcp_listen_opts_t halfclose_opts = {TCP_SYN_BACKLOG, TCP_ACCEPT_BACKLOG, .close_handler = tcp_halfclose_handler};
+    tcp_listen(60010, tcp_handler, &halfclose_opts);
+    tcp_open(60011, tcp_bulk_handler);  // 收到请求后发出超过发送队列容量的响应
+    tcp_open(60012, tcp_port_close_handler);  // 回显，收到 close 时关闭整个端口
+    // 以客户端身份主动打开连接
+    if (argc > 2 && strcmp(argv[2], "connect") == 0) {
+        uint8_t server_ip[NET_IP_LEN] = {192, 168, 163, 10};
+        tcp_connect(60004, server_ip, 56446, tcp_client_handler, tcp_client_connect_handler);
+    }
     log_tab_buf();
     int i = 1;
     PRINT_INFO("Feeding input %02d", i);
     while ((ret = driver_recv(&buf)) > 0) {
         printf("\b\b%02d", i);
         fprintf(control_flow, "\nRound %02d -----------------------------\n", i++);
+        tcp_poll();  // 先处理在该报文到达之前到期的计时器
         ethernet_in(&buf);
         log_tab_buf();
     }
@@ -26,6 +26,7 @@ uint8_t boardcast_mac[] = {0xff, 0xff, 0xff, 0xff, 0xff, 0xff};
 int check_log();
 int check_pcap();
 FILE *open_file(char *path, char *name, char *mode);
+void load_config(char *path);
 
 void log_tab_buf();
 
@@ -37,6 +38,13 @@ void udp_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port)
     udp_send(data, len, 60000, src_ip, src_port);  // 发送udp包
 }
 
+#ifdef IPV6
+void udp6_handler(uint8_t *data, size_t len, uint8_t *src_ip, uint16_t src_port) {
+    printf("recv udp6 packet from [%s]:%u len=%zu\n", ip6tos(src_ip), src_port, len);
+    udp6_send(data, len, 60000, src_ip, src_port);
+}
+#endif
+
 buf_t buf;
 int main(int argc, char *argv[]) {
     int ret;
@@ -63,8 +71,12 @@ int main(int argc, char *argv[]) {
     tcp_fout = control_flow;
     arp_log_f = control_flow;
 
+    load_config(argv[1]);
     net_init();
     udp_open(60000, udp_handler);  // 注册端口的udp监听回调
+#ifdef IPV6
+    udp6_open(60000, udp6_handler);
+#endif
     log_tab_buf();
     int i = 1;
     PRINT_INFO("Feeding input %02d", i);